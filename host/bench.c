@@ -0,0 +1,1273 @@
+/* ============================================================================
+ * Host Benchmark and Render Check for the SSD1306 Driver
+ *
+ * Builds src/myssd1306.c for the PC against the mock I2C bus in this
+ * directory, one PlatformIO environment per panel size:
+ *
+ *   pio run -e host_128x32 -t exec
+ *   .pio/build/host_128x32/program -c      (to pass options)
+ *
+ * - every fast drawing path is compared with the same picture drawn one
+ *   pixel at a time through ssd1306_drawPixel() / ssd1306_xorPixel()
+ * - the buffer after every scene is compared with its CRC-32 in golden.h
+ * - every refresh path must leave the modelled panel showing the buffer
+ * - primitives and refresh variants are timed in ns/op, with the bus bytes
+ *   and transactions each of them costs
+ *
+ * Options: -c checks only, -g print the golden.h row for this panel size.
+ * The exit status is non-zero when a check fails.
+ * ============================================================================ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "myssd1306.h"
+#include "mock_i2c.h"
+
+#if !SSD1306_FRAMEBUFFER
+	#error "the host harness draws into ssd1306_buffer, it needs SSD1306_FRAMEBUFFER"
+#endif
+#if SSD1306_USE_DMA || SSD1306_USE_IRQ || SSD1306_STATS_TIMING
+	#error "SSD1306_USE_DMA, SSD1306_USE_IRQ and SSD1306_STATS_TIMING need the CH32V003 peripherals"
+#endif
+
+// Minimum time spent on each benchmark case
+#ifndef BENCH_MIN_NS
+#define BENCH_MIN_NS 20000000ull
+#endif
+
+#define BENCH_FB_SIZE (SSD1306_W * SSD1306_H / 8)
+
+static i2c_device_t bench_dev = {
+	.clkr = I2C_CLK_400KHZ,
+	.type = I2C_ADDR_7BIT,
+	.addr = 0x3C,
+	.regb = 1,
+	.tout = 2000,
+};
+
+static uint32_t bench_failures;
+
+static void check(int ok, const char *what)
+{
+	if(!ok)
+	{
+		printf("FAIL %s\n", what);
+		bench_failures++;
+	}
+}
+
+static uint32_t bench_crc32(const uint8_t *p, uint32_t n)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	while(n--)
+	{
+		crc ^= *p++;
+		for(int k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+/*
+ * fixed pseudo-random picture, so clearing and the blend modes show
+ */
+static void bench_noise(uint8_t *dst, uint32_t n, uint32_t seed)
+{
+	while(n--)
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		*dst++ = seed;
+	}
+}
+
+static void bench_background(void)
+{
+	bench_noise(ssd1306_buffer, BENCH_FB_SIZE, 0x12345678);
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_mark_dirty(0, 0, SSD1306_W, SSD1306_H);
+#endif
+}
+
+/* ============================================================================
+ * TEST IMAGES
+ * ============================================================================ */
+
+// page-format image with a height that is not a page multiple
+#define IMG_W 24
+#define IMG_H 21
+static uint8_t bench_page_img[IMG_W * ((IMG_H + 7) / 8)];
+static uint8_t bench_rle_img[2 * sizeof(bench_page_img)];
+
+// row-major image for ssd1306_drawImage()
+#define ROW_IMG_W 32
+#define ROW_IMG_H 16
+static uint8_t bench_row_img[ROW_IMG_W / 8 * ROW_IMG_H];
+
+// full-screen image for ssd1306_streamRleImage()
+static uint8_t bench_screen_img[BENCH_FB_SIZE];
+static uint8_t bench_screen_rle[2 * BENCH_FB_SIZE];
+
+/*
+ * same encoding as tools/img2page.py --rle
+ */
+static uint32_t bench_rle(uint8_t *out, const uint8_t *in, uint32_t n)
+{
+	uint32_t i = 0, o = 0, lit = 0, run;
+
+	while(i < n)
+	{
+		run = 1;
+		while(i + run < n && run < 129 && in[i + run] == in[i])
+			run++;
+		if(run >= 3 || (run == 2 && !lit))
+		{
+			if(lit)
+			{
+				out[o++] = lit - 1;
+				memcpy(&out[o], &in[i - lit], lit);
+				o += lit;
+				lit = 0;
+			}
+			out[o++] = 0x80 | (run - 2);
+			out[o++] = in[i];
+			i += run;
+			continue;
+		}
+		lit++;
+		i++;
+		if(lit == 128)
+		{
+			out[o++] = 127;
+			memcpy(&out[o], &in[i - lit], lit);
+			o += lit;
+			lit = 0;
+		}
+	}
+	if(lit)
+	{
+		out[o++] = lit - 1;
+		memcpy(&out[o], &in[i - lit], lit);
+		o += lit;
+	}
+	return o;
+}
+
+static void bench_images(void)
+{
+	uint32_t x, p;
+
+	// solid columns, empty columns and noise, so RLE has runs and literals
+	for(p = 0; p < (IMG_H + 7) / 8; p++)
+		for(x = 0; x < IMG_W; x++)
+			bench_page_img[p * IMG_W + x] = (x < 5) ? 0xFF : (x < 9) ? 0x00 :
+				(uint8_t)((x * 37 + p * 91) ^ (x << 3));
+	bench_rle(bench_rle_img, bench_page_img, sizeof(bench_page_img));
+
+	bench_noise(bench_row_img, sizeof(bench_row_img), 0xCAFE);
+	memset(bench_row_img, 0xF0, ROW_IMG_W / 8 * 2);
+
+	bench_noise(bench_screen_img, sizeof(bench_screen_img), 0xBEEF);
+	memset(bench_screen_img, 0, sizeof(bench_screen_img) / 2);
+	bench_rle(bench_screen_rle, bench_screen_img, sizeof(bench_screen_img));
+}
+
+/* ============================================================================
+ * DRAWING PATHS
+ * ============================================================================ */
+
+// the primitives under test, implemented by the driver or pixel by pixel
+typedef struct {
+	void (*hline)(int32_t x, int32_t y, int32_t w, uint32_t color);
+	void (*vline)(int32_t x, int32_t y, int32_t h, uint32_t color);
+	void (*line)(int x0, int y0, int x1, int y1, uint32_t color);
+	void (*rect)(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color);
+	void (*fillrect)(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t color);
+	void (*xorrect)(int32_t x, int32_t y, int32_t w, int32_t h);
+	void (*circle)(int x, int y, int radius, int color);
+	void (*fillcircle)(int x, int y, int radius, int color);
+	void (*fillroundrect)(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color);
+	void (*chr)(uint8_t x, uint8_t y, uint8_t chr, uint8_t color);
+	void (*chr_sz)(uint8_t x, uint8_t y, uint8_t chr, uint8_t color, font_size_t font_size);
+	void (*image)(uint32_t x, uint32_t y, const unsigned char *input, uint32_t width, uint32_t height, uint32_t color_mode);
+	void (*pageimage)(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode);
+	void (*benchimage)(int32_t x, int32_t y, uint32_t color_mode);
+	void (*str_font)(int32_t x, int32_t y, const char *str, uint8_t color);
+} bench_gfx_t;
+
+static void ref_pixel(int32_t x, int32_t y, int color)
+{
+	ssd1306_drawPixel((uint32_t)x, (uint32_t)y, color);
+}
+
+static void ref_hline(int32_t x, int32_t y, int32_t w, uint32_t color)
+{
+	for(int32_t i = 0; i < w; i++)
+		ref_pixel(x + i, y, color);
+}
+
+static void ref_vline(int32_t x, int32_t y, int32_t h, uint32_t color)
+{
+	for(int32_t i = 0; i < h; i++)
+		ref_pixel(x, y + i, color);
+}
+
+/*
+ * the Bresenham loop the driver started from
+ */
+static void ref_line(int x0, int y0, int x1, int y1, uint32_t color)
+{
+	int steep = gfx_abs(y1 - y0) > gfx_abs(x1 - x0);
+	int dx, dy, err, ystep, x, y;
+
+	if(steep)
+	{
+		gfx_swap(&x0, &y0);
+		gfx_swap(&x1, &y1);
+	}
+	if(x0 > x1)
+	{
+		gfx_swap(&x0, &x1);
+		gfx_swap(&y0, &y1);
+	}
+	dx = x1 - x0;
+	dy = gfx_abs(y1 - y0);
+	err = dx / 2;
+	y = y0;
+	ystep = (y0 < y1) ? 1 : -1;
+	for(x = x0; x <= x1; x++)
+	{
+		if(steep)
+			ref_pixel(y, x, color);
+		else
+			ref_pixel(x, y, color);
+		err -= dy;
+		if(err < 0)
+		{
+			y += ystep;
+			err += dx;
+		}
+	}
+}
+
+static void ref_rect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color)
+{
+	ref_vline(x, y, h, color);
+	ref_vline(x + w - 1, y, h, color);
+	ref_hline(x, y, w, color);
+	ref_hline(x, y + h - 1, w, color);
+}
+
+static void ref_fillrect(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t color)
+{
+	for(uint32_t j = 0; j < h; j++)
+		ref_hline(x, y + j, w, color);
+}
+
+static void ref_xorrect(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	for(int32_t j = 0; j < h; j++)
+		for(int32_t i = 0; i < w; i++)
+			ssd1306_xorPixel((uint32_t)(x + i), (uint32_t)(y + j));
+}
+
+static void ref_circle(int x, int y, int radius, int color)
+{
+	int x_pos = -radius, y_pos = 0, err = 2 - 2 * radius, e2;
+
+	do {
+		ref_pixel(x - x_pos, y + y_pos, color);
+		ref_pixel(x + x_pos, y + y_pos, color);
+		ref_pixel(x + x_pos, y - y_pos, color);
+		ref_pixel(x - x_pos, y - y_pos, color);
+		e2 = err;
+		if(e2 <= y_pos)
+		{
+			err += ++y_pos * 2 + 1;
+			if(-x_pos == y_pos && e2 <= x_pos)
+				e2 = 0;
+		}
+		if(e2 > x_pos)
+			err += ++x_pos * 2 + 1;
+	} while(x_pos <= 0);
+}
+
+/*
+ * the circle outline stretched apart at the centre lines, every row of it
+ * filled: a filled circle for xl == xr and yt == yb
+ */
+static void ref_round(int xl, int xr, int yt, int yb, int r, int color)
+{
+	int x_pos = -r, y_pos = 0, err = 2 - 2 * r, e2;
+
+	for(int y = yt + 1; y < yb; y++)
+		ref_hline(xl - r, y, xr - xl + 2 * r + 1, color);
+	do {
+		ref_hline(xl + x_pos, yt - y_pos, xr - xl - 2 * x_pos + 1, color);
+		ref_hline(xl + x_pos, yb + y_pos, xr - xl - 2 * x_pos + 1, color);
+		e2 = err;
+		if(e2 <= y_pos)
+		{
+			err += ++y_pos * 2 + 1;
+			if(-x_pos == y_pos && e2 <= x_pos)
+				e2 = 0;
+		}
+		if(e2 > x_pos)
+			err += ++x_pos * 2 + 1;
+	} while(x_pos <= 0);
+}
+
+static void ref_fillcircle(int x, int y, int radius, int color)
+{
+	ref_round(x, x, y, y, radius, color);
+}
+
+static void ref_fillroundrect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color)
+{
+	if(r > (w - 1) / 2) r = (w - 1) / 2;
+	if(r > (h - 1) / 2) r = (h - 1) / 2;
+	ref_round(x + r, x + w - 1 - r, y + r, y + h - 1 - r, r, color);
+}
+
+static void ref_glyph(int32_t x, int32_t y, uint8_t chr, uint8_t color, uint32_t scale)
+{
+	for(uint32_t i = 0; i < 8; i++)
+	{
+		uint8_t d = fontdata[(chr << 3) + i];
+
+		for(uint32_t j = 0; j < 8; j++, d <<= 1)
+			for(uint32_t k = 0; k < scale * scale; k++)
+				ref_pixel(x + j * scale + k % scale, y + i * scale + k / scale,
+					(d & 0x80) ? color : (~color) & 1);
+	}
+}
+
+static void ref_chr(uint8_t x, uint8_t y, uint8_t chr, uint8_t color)
+{
+	ref_glyph(x, y, chr, color, 1);
+}
+
+static void ref_chr_sz(uint8_t x, uint8_t y, uint8_t chr, uint8_t color, font_size_t font_size)
+{
+	ref_glyph(x, y, chr, color, font_size);
+}
+
+/*
+ * one image pixel written with a blend mode
+ */
+static void ref_blend(int32_t x, int32_t y, uint32_t bit, uint32_t color_mode)
+{
+	switch(color_mode)
+	{
+		case imagemode_copy:   ref_pixel(x, y, bit); break;
+		case imagemode_invert: ref_pixel(x, y, !bit); break;
+		case imagemode_and:    if(!bit) ref_pixel(x, y, 0); break;
+		case imagemode_or:     if(bit) ref_pixel(x, y, 1); break;
+		case imagemode_ornot:  if(!bit) ref_pixel(x, y, 1); break;
+		case imagemode_andnot: if(bit) ref_pixel(x, y, 0); break;
+		case imagemode_xor:    if(bit) ssd1306_xorPixel((uint32_t)x, (uint32_t)y); break;
+	}
+}
+
+/*
+ * row-major images come out with their bytes in reverse order, as they
+ * always have
+ */
+static void ref_image(uint32_t x, uint32_t y, const unsigned char *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	uint32_t bytes = width / 8;
+
+	for(uint32_t line = 0; line < height; line++)
+		for(uint32_t byte = 0; byte < bytes; byte++)
+			for(uint32_t pixel = 0; pixel < 8; pixel++)
+				ref_blend(x + 8 * (bytes - byte) + pixel, y + line,
+					(input[byte + line * bytes] >> pixel) & 1, color_mode);
+}
+
+static void ref_pageimage(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	for(uint32_t j = 0; j < height; j++)
+		for(uint32_t i = 0; i < width; i++)
+			ref_blend(x + i, y + j, (input[(j / 8) * width + i] >> (j & 7)) & 1, color_mode);
+}
+
+static void ref_benchimage(int32_t x, int32_t y, uint32_t color_mode)
+{
+	ref_pageimage(x, y, bench_page_img, IMG_W, IMG_H, color_mode);
+}
+
+static void fast_benchimage(int32_t x, int32_t y, uint32_t color_mode)
+{
+	ssd1306_drawRleImage(x, y, bench_rle_img, IMG_W, IMG_H, color_mode);
+}
+
+static void ref_str_font(int32_t x, int32_t y, const char *str, uint8_t color)
+{
+	for(; *str; str++, x += 8)
+		ref_glyph(x, y, *str, color, 1);
+}
+
+static void fast_str_font(int32_t x, int32_t y, const char *str, uint8_t color)
+{
+#ifdef SSD1306_FONT_CM
+	ssd1306_drawstr_font(x, y, str, color, &ssd1306_font8x8);
+#else
+	// no descriptor for the built-in font without the column-major copy
+	for(; *str; str++, x += 8)
+		ssd1306_drawchar(x, y, *str, color);
+#endif
+}
+
+static const bench_gfx_t bench_fast = {
+	ssd1306_drawFastHLine, ssd1306_drawFastVLine, ssd1306_drawLine,
+	ssd1306_drawRect, ssd1306_fillRect, ssd1306_xorrect,
+	ssd1306_drawCircle, ssd1306_fillCircle, ssd1306_fillRoundRect,
+	ssd1306_drawchar, ssd1306_drawchar_sz,
+	ssd1306_drawImage, ssd1306_drawPageImage, fast_benchimage,
+	fast_str_font,
+};
+
+static const bench_gfx_t bench_ref = {
+	ref_hline, ref_vline, ref_line,
+	ref_rect, ref_fillrect, ref_xorrect,
+	ref_circle, ref_fillcircle, ref_fillroundrect,
+	ref_chr, ref_chr_sz,
+	ref_image, ref_pageimage, ref_benchimage,
+	ref_str_font,
+};
+
+/* ============================================================================
+ * SCENES
+ * ============================================================================ */
+
+#define W ((int)SSD1306_W)
+#define H ((int)SSD1306_H)
+
+static void scene_hline(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 40; i++)
+		g->hline(i * 13 % (W + 24) - 12, i * (H + 4) / 40 - 2, 1 + i * 7 % (W + 8), i % 3 != 0);
+}
+
+static void scene_vline(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 40; i++)
+		g->vline(i * (W + 4) / 40 - 2, i * 11 % (H + 16) - 8, 1 + i * 5 % (H + 8), i % 3 != 0);
+}
+
+static void scene_line(const bench_gfx_t *g)
+{
+	// a fan reaching past every edge, and a few short ones
+	for(int i = 0; i < 32; i++)
+	{
+		int px = (i < 16) ? i * (W + 40) / 15 - 20 : (i & 1) ? -20 : W + 20;
+		int py = (i < 16) ? ((i & 1) ? -15 : H + 15) : (i - 16) * (H + 30) / 15 - 15;
+		g->line(W / 2, H / 2, px, py, i & 1);
+	}
+	for(int i = 0; i < 16; i++)
+		g->line(i * 7 % W, i * 5 % H, i * 7 % W + i - 8, i * 5 % H + (i * 3) % 11 - 5, 1);
+}
+
+static void scene_rect(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 12; i++)
+		g->rect(i * 9 % W - 4, i * 5 % H - 3, 2 + i * 6, 2 + i * 3, i & 1);
+}
+
+static void scene_fillrect(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 12; i++)
+		g->fillrect(i * 11 % W, i * 7 % H, 56 - i * 5, 1 + i * 3 % 23, (i % 3) != 1);
+}
+
+static void scene_xorrect(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 10; i++)
+		g->xorrect(i * 13 % W - 6, i * 9 % H - 4, 3 + i * 7, 2 + i * 5);
+}
+
+static void scene_circle(const bench_gfx_t *g)
+{
+	for(int r = 0; r < 24; r++)
+		g->circle(r * 17 % (W + 20) - 10, r * 7 % (H + 10) - 5, r * 3 / 2, r & 1);
+}
+
+static void scene_fillcircle(const bench_gfx_t *g)
+{
+	// largest first, so the small ones stay visible
+	for(int r = 0; r < 16; r++)
+		g->fillcircle(r * 19 % (W + 20) - 10, r * 11 % (H + 10) - 5, 30 - r * 2, (r % 3) != 0);
+}
+
+static void scene_fillroundrect(const bench_gfx_t *g)
+{
+	for(int i = 0; i < 12; i++)
+		g->fillroundrect(i * 23 % W - 8, i * 13 % H - 6, 3 + i * 9 % 60, 3 + i * 7 % 40, i * 3 % 17, i & 1);
+}
+
+static void scene_char(const bench_gfx_t *g)
+{
+	for(int c = 0; c < 256; c++)
+		g->chr(c % 16 * 9 - 4, c / 16 * 10 - (c & 3), c, (c / 16) & 1);
+}
+
+static void scene_char_sz(const bench_gfx_t *g)
+{
+	g->chr_sz(1, 3, '8', 1, fontsize_16x16);
+	g->chr_sz(W / 2 - 5, 1, 'A', 0, fontsize_16x16);
+	g->chr_sz(W - 30, H - 20, 'g', 1, fontsize_32x32);
+	g->chr_sz(3, 10, '%', 1, fontsize_64x64);
+}
+
+static void scene_image(const bench_gfx_t *g)
+{
+	for(int m = imagemode_copy; m <= imagemode_andnot; m++)
+		g->image(m * 19 % W - 8, m * 11 % H, bench_row_img, ROW_IMG_W, ROW_IMG_H, m);
+}
+
+static void scene_pageimage(const bench_gfx_t *g)
+{
+	for(int m = imagemode_copy; m <= imagemode_xor; m++)
+	{
+		g->pageimage(m * 17 % W - 10, m * 8 - 6, bench_page_img, IMG_W, IMG_H, m);
+		g->pageimage(W - 12 - m, m * 13 % H - 3, bench_page_img, IMG_W, IMG_H, m);
+	}
+}
+
+static void scene_rleimage(const bench_gfx_t *g)
+{
+	for(int m = imagemode_copy; m <= imagemode_xor; m++)
+	{
+		g->benchimage(m * 17 % W - 10, m * 8 - 6, m);
+		g->benchimage(W - 12 - m, m * 13 % H - 3, m);
+	}
+}
+
+static void scene_font(const bench_gfx_t *g)
+{
+	g->str_font(0, 0, "Font 8x8", 1);
+	g->str_font(5, 11, "Hello, world", 0);
+	g->str_font(W - 20, H - 5, "edge", 1);
+}
+
+static void scene_str(const bench_gfx_t *g)
+{
+	(void)g;
+	ssd1306_drawstr(0, 0, "0123456789ABCDEFGHIJ", 1);
+	ssd1306_drawstr(4, 13, "unaligned", 0);
+	ssd1306_drawstr_sz(2, H - 16, "Sz2", 1, fontsize_16x16);
+}
+
+static void scene_roundrect(const bench_gfx_t *g)
+{
+	(void)g;
+	for(int i = 0; i < 12; i++)
+		ssd1306_drawRoundRect(i * 23 % W - 8, i * 13 % H - 6, 3 + i * 9 % 60, 3 + i * 7 % 40, i * 3 % 17, i & 1);
+}
+
+/*
+ * pixel path draws directly, fast path records and replays a display list
+ */
+static void scene_dlist(const bench_gfx_t *g)
+{
+	static ssd1306_dl_op_t ops[32];
+	ssd1306_dl_t dl;
+
+	if(g == &bench_ref)
+	{
+		ssd1306_drawLine(0, 0, W - 1, H - 1, 1);
+		ssd1306_fillCircle(W / 3, H / 2, H / 4, 1);
+		ssd1306_drawRoundRect(W / 2, 2, W / 3, H - 4, 5, 1);
+		ssd1306_xorrect(4, 4, W / 2, H / 3);
+		ssd1306_drawstr(2, H - 8, "DL", 0);
+		ssd1306_drawRleImage(W - IMG_W, H - IMG_H, bench_rle_img, IMG_W, IMG_H, imagemode_or);
+		return;
+	}
+	ssd1306_dl_init(&dl, ops, 32);
+	ssd1306_dl_begin(&dl);
+	ssd1306_dl_drawLine(&dl, 0, 0, W - 1, H - 1, 1);
+	ssd1306_dl_fillCircle(&dl, W / 3, H / 2, H / 4, 1);
+	ssd1306_dl_drawRoundRect(&dl, W / 2, 2, W / 3, H - 4, 5, 1);
+	ssd1306_dl_xorrect(&dl, 4, 4, W / 2, H / 3);
+	ssd1306_dl_drawstr(&dl, 2, H - 8, "DL", 0);
+	ssd1306_dl_drawRleImage(&dl, W - IMG_W, H - IMG_H, bench_rle_img, IMG_W, IMG_H, imagemode_or);
+	ssd1306_dl_end(&dl);
+	ssd1306_dl_replay(&dl, 0, 0, W, H);
+}
+
+typedef struct {
+	const char *name;
+	void (*draw)(const bench_gfx_t *g);
+	uint8_t pixel_ref;   // the pixel path must draw the same picture
+	uint8_t text;        // draws with fontdata, golden CRCs do not cover it
+} bench_scene_t;
+
+static const bench_scene_t bench_scenes[] = {
+	{ "hline",         scene_hline,         1, 0 },
+	{ "vline",         scene_vline,         1, 0 },
+	{ "line",          scene_line,          1, 0 },
+	{ "rect",          scene_rect,          1, 0 },
+	{ "fillRect",      scene_fillrect,      1, 0 },
+	{ "xorrect",       scene_xorrect,       1, 0 },
+	{ "circle",        scene_circle,        1, 0 },
+	{ "fillCircle",    scene_fillcircle,    1, 0 },
+	{ "fillRoundRect", scene_fillroundrect, 1, 0 },
+	{ "char",          scene_char,          1, 1 },
+	{ "char_sz",       scene_char_sz,       1, 1 },
+	{ "image",         scene_image,         1, 0 },
+	{ "pageImage",     scene_pageimage,     1, 0 },
+	{ "rleImage",      scene_rleimage,      1, 0 },
+	{ "font",          scene_font,          1, 1 },
+	{ "display list",  scene_dlist,         1, 1 },
+	{ "str",           scene_str,           0, 1 },
+	{ "roundRect",     scene_roundrect,     0, 0 },
+};
+
+#define BENCH_SCENES (sizeof(bench_scenes) / sizeof(bench_scenes[0]))
+
+typedef struct {
+	uint32_t w, h;
+	uint32_t crc[BENCH_SCENES];
+} bench_golden_t;
+
+#include "golden.h"
+
+static void bench_render(const bench_scene_t *s, const bench_gfx_t *g)
+{
+	bench_background();
+	s->draw(g);
+}
+
+/*
+ * fast paths against pixel paths and golden CRCs
+ */
+static void check_scenes(int print_golden)
+{
+	static uint8_t ref[BENCH_FB_SIZE];
+	const bench_golden_t *golden = NULL;
+	uint32_t crc[BENCH_SCENES];
+	char what[80];
+
+	for(uint32_t i = 0; i < sizeof(bench_golden) / sizeof(bench_golden[0]); i++)
+		if(bench_golden[i].w == SSD1306_W && bench_golden[i].h == SSD1306_H)
+			golden = &bench_golden[i];
+	if(!golden && !print_golden)
+		printf("no golden CRCs for %ux%u, run with -g to make them\n", SSD1306_W, SSD1306_H);
+
+	for(uint32_t i = 0; i < BENCH_SCENES; i++)
+	{
+		const bench_scene_t *s = &bench_scenes[i];
+
+		if(s->pixel_ref)
+		{
+			bench_render(s, &bench_ref);
+			memcpy(ref, ssd1306_buffer, BENCH_FB_SIZE);
+		}
+		bench_render(s, &bench_fast);
+		crc[i] = bench_crc32(ssd1306_buffer, BENCH_FB_SIZE);
+
+		snprintf(what, sizeof(what), "%s: fast path differs from pixel path", s->name);
+		check(!s->pixel_ref || !memcmp(ref, ssd1306_buffer, BENCH_FB_SIZE), what);
+		snprintf(what, sizeof(what), "%s: CRC %08x, golden %08x", s->name,
+			crc[i], golden ? golden->crc[i] : 0);
+		check(!golden || s->text || golden->crc[i] == crc[i], what);
+	}
+
+	if(print_golden)
+	{
+		printf("\t{ %u, %u, {", SSD1306_W, SSD1306_H);
+		for(uint32_t i = 0; i < BENCH_SCENES; i++)
+			printf("%s0x%08x,", (i % 6) ? " " : "\n\t\t", bench_scenes[i].text ? 0 : crc[i]);
+		printf("\n\t} },\n");
+	}
+}
+
+/* ============================================================================
+ * REFRESH PATHS
+ * ============================================================================ */
+
+/*
+ * the modelled panel shows exactly ssd1306_buffer
+ */
+static int bench_panel_ok(void)
+{
+	for(uint32_t y = 0; y < SSD1306_PANEL_H; y++)
+		for(uint32_t x = 0; x < SSD1306_PANEL_W; x++)
+		{
+#if SSD1306_ROTATE_90
+			uint32_t bx = y, by = SSD1306_PANEL_W - 1 - x;
+#else
+			uint32_t bx = x, by = y;
+#endif
+			if(mock_panel_pixel(x, y) != ((ssd1306_buffer[bx + SSD1306_W * (by / 8)] >> (by & 7)) & 1))
+				return 0;
+		}
+	return 1;
+}
+
+/*
+ * panel RAM no longer holds what the driver last sent
+ */
+static void bench_panel_lost(void)
+{
+	mock_i2c_reset(0xA5);
+	check(!ssd1306_set_start_line(&bench_dev, 0), "start line reset");
+#if SSD1306_PAGE_HASH
+	ssd1306_refresh_invalidate();
+#endif
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_mark_dirty(0, 0, SSD1306_W, SSD1306_H);
+#endif
+}
+
+// the cheapest refresh the build offers
+static uint8_t bench_flush(void)
+{
+#if SSD1306_DIRTY_TRACKING
+	return ssd1306_refresh_dirty(&bench_dev);
+#else
+	return ssd1306_refresh(&bench_dev);
+#endif
+}
+
+#if SSD1306_STRIP_PAGES
+static void bench_strip_draw(void *arg)
+{
+	((const bench_scene_t *)arg)->draw(&bench_fast);
+}
+#endif
+
+static void check_refresh(void)
+{
+	bench_render(&bench_scenes[2], &bench_fast);
+	bench_panel_lost();
+	check(!ssd1306_refresh(&bench_dev) && bench_panel_ok(), "refresh");
+
+#if SSD1306_PAGE_HASH
+	mock_i2c_reset_counts();
+	check(!ssd1306_refresh(&bench_dev) && !mock_i2c.data_xfers, "refresh of unchanged pages sends data");
+	ssd1306_xorPixel(3, SSD1306_H - 1);
+	mock_i2c_reset_counts();
+	check(!ssd1306_refresh(&bench_dev) && bench_panel_ok() && mock_i2c.data_xfers == 1,
+		"refresh after one pixel changed");
+#endif
+
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_drawchar(SSD1306_W / 2, 13, 'D', 1);
+	mock_i2c_reset_counts();
+	check(!ssd1306_refresh_dirty(&bench_dev) && bench_panel_ok() &&
+		mock_i2c.bytes <= 2 * (8 + 2 + 8), "refresh_dirty of one glyph over two pages");
+
+	scene_circle(&bench_fast);
+	for(int i = 0; i < 100000 && ssd1306_refresh_pending(); i++)
+		ssd1306_refresh_step(&bench_dev, 40);
+	check(!ssd1306_refresh_pending() && bench_panel_ok(), "refresh_step");
+
+#endif
+
+	scene_xorrect(&bench_fast);
+	mock_i2c.fail_every = 3;
+	check(bench_flush() != 0, "NACKs reported");
+	mock_i2c.fail_every = 0;
+	check(!bench_flush() && bench_panel_ok(), "refresh after NACKs");
+
+#if SSD1306_CLOCK_ADAPT
+	mock_i2c.max_clk = I2C_CLK_750KHZ;
+	check(ssd1306_clock_calibrate(&bench_dev, I2C_CLK_1MHZ) == I2C_CLK_750KHZ &&
+		mock_i2c.clk == I2C_CLK_750KHZ, "clock_calibrate settles on the fastest working step");
+	mock_i2c.max_clk = I2C_CLK_500KHZ;
+	scene_circle(&bench_fast);
+	for(int i = 0; i < 8 && bench_flush(); i++);
+	check(bench_dev.clkr == I2C_CLK_500KHZ && mock_i2c.clk == I2C_CLK_500KHZ, "clock falls back after errors");
+	check(!ssd1306_refresh(&bench_dev) && bench_panel_ok(), "refresh after clock fallback");
+	mock_i2c.max_clk = I2C_CLK_100KHZ;
+	scene_xorrect(&bench_fast);
+	for(int i = 0; i < 8; i++)
+		bench_flush();
+	check(bench_dev.clkr == I2C_CLK_400KHZ, "clock stays at the calibration start rate");
+	mock_i2c.max_clk = 0;
+	check(!ssd1306_refresh(&bench_dev) && bench_panel_ok(), "refresh at the start rate");
+#endif
+
+#if !SSD1306_ROTATE_90
+	ssd1306_xorrect(5, 3, 20, 13);
+	mock_i2c_reset_counts();
+	check(!ssd1306_refresh_rect(&bench_dev, 5, 3, 20, 13) && bench_panel_ok() &&
+		mock_i2c.cmd_xfers == 1, "refresh_rect in one window");
+
+	check(!ssd1306_set_start_line(&bench_dev, 16), "set_start_line");
+	check(!bench_flush() && bench_panel_ok(), "refresh after set_start_line");
+
+	check(!ssd1306_scroll_pages(&bench_dev, 1), "scroll_pages");
+	ssd1306_drawstr(0, SSD1306_H - 8, "scrolled in", 1);
+	check(!bench_flush() && bench_panel_ok(), "refresh after scroll_pages");
+	check(!ssd1306_set_start_line(&bench_dev, 0) && !ssd1306_refresh(&bench_dev) && bench_panel_ok(),
+		"refresh after start line reset");
+
+	{
+		static uint8_t direct[BENCH_FB_SIZE];
+
+		check(!ssd1306_drawstr_direct(&bench_dev, 3, 1, "Direct", 1, 1) && bench_panel_ok(),
+			"drawstr_direct");
+		memcpy(direct, ssd1306_buffer, BENCH_FB_SIZE);
+		ssd1306_drawstr(3, 8, "Direct", 1);
+		check(!memcmp(direct, ssd1306_buffer, BENCH_FB_SIZE), "drawstr_direct draws like drawstr");
+		check(!ssd1306_drawstr_direct(&bench_dev, 3, 2, "Scratch", 1, 0) && !bench_panel_ok(),
+			"drawstr_direct without keep");
+		check(!bench_flush() && bench_panel_ok(), "refresh after drawstr_direct without keep");
+		check(!ssd1306_drawstr_direct(&bench_dev, 3, 2, "Scratch", 1, 0) && !ssd1306_refresh(&bench_dev) &&
+			bench_panel_ok(), "full refresh after drawstr_direct without keep");
+	}
+
+	{
+		int ok = !ssd1306_streamRleImage(&bench_dev, bench_screen_rle);
+
+		memcpy(ssd1306_buffer, bench_screen_img, BENCH_FB_SIZE);
+		check(ok && bench_panel_ok(), "streamRleImage");
+		bench_background();
+		check(!ssd1306_refresh(&bench_dev) && bench_panel_ok(), "refresh after streamRleImage");
+	}
+#endif
+
+#if SSD1306_STRIP_PAGES
+	for(uint32_t i = 0; i < BENCH_SCENES; i++)
+	{
+		char what[80];
+		int ok = !ssd1306_render_strips(&bench_dev, bench_strip_draw, (void *)&bench_scenes[i]);
+
+		ssd1306_setbuf(0);
+		bench_scenes[i].draw(&bench_fast);
+		snprintf(what, sizeof(what), "%s: render_strips differs from the frame buffer", bench_scenes[i].name);
+		check(ok && bench_panel_ok(), what);
+	}
+
+	bench_background();
+	check(!ssd1306_refresh(&bench_dev) && !ssd1306_render_strips(&bench_dev, NULL, NULL),
+		"render_strips over the frame buffer");
+	ssd1306_drawPixel(1, 1, 1);
+	check(!bench_flush() && bench_panel_ok(), "refresh after render_strips");
+#endif
+
+	{
+		static ssd1306_dl_op_t ops[8];
+		ssd1306_dl_t dl;
+
+		ssd1306_dl_init(&dl, ops, 8);
+		ssd1306_dl_begin(&dl);
+		ssd1306_dl_fillRoundRect(&dl, 2, 2, SSD1306_W - 4, SSD1306_H - 4, 6, 1);
+		ssd1306_dl_drawstr(&dl, 8, 8, "list", 0);
+		check(!ssd1306_dl_render(&dl, &bench_dev) && bench_panel_ok(), "dl_render");
+		ssd1306_dl_begin(&dl);
+		ssd1306_dl_fillRoundRect(&dl, 2, 2, SSD1306_W - 4, SSD1306_H - 4, 6, 1);
+		ssd1306_dl_drawstr(&dl, 8, 8, "list", 0);
+		mock_i2c_reset_counts();
+		check(!ssd1306_dl_render(&dl, &bench_dev) && !mock_i2c.xfers, "dl_render of an unchanged frame");
+	}
+
+	{
+		static ssd1306_dl_op_t ops[2][4];
+		ssd1306_dl_t dl[2];
+
+		/* whatever sits in the padding of an op must not reach the hash */
+		memset(ops[0], 0x00, sizeof(ops[0]));
+		memset(ops[1], 0xAA, sizeof(ops[1]));
+		for(int i = 0; i < 2; i++)
+		{
+			ssd1306_dl_init(&dl[i], ops[i], 4);
+			ssd1306_dl_begin(&dl[i]);
+			ssd1306_dl_drawLine(&dl[i], 0, 0, SSD1306_W - 1, SSD1306_H - 1, 1);
+			ssd1306_dl_drawstr(&dl[i], 8, 8, "list", 0);
+		}
+		check(dl[0].hash == dl[1].hash, "dl hash independent of op padding");
+	}
+
+	{
+		static uint8_t save[SSD1306_SPRITE_SAVE(IMG_W, IMG_H)];
+		static uint8_t bg[BENCH_FB_SIZE], want[BENCH_FB_SIZE];
+		ssd1306_sprite_t spr[2];
+		int moved = 1, restored;
+
+		bench_background();
+		check(!ssd1306_refresh(&bench_dev), "refresh before sprites");
+		memcpy(bg, ssd1306_buffer, sizeof(bg));
+		ssd1306_sprite_init(&spr[0], bench_page_img, IMG_W, IMG_H, imagemode_or, save);
+		ssd1306_sprite_init(&spr[1], bench_page_img, IMG_W, IMG_H, imagemode_xor, NULL);
+		for(int f = 0; f < 24; f++)
+		{
+			spr[0].x = (f * 7) % (SSD1306_W + 20) - 10;
+			spr[0].y = (f * 3) % (SSD1306_H + 10) - 5;
+			spr[1].x = spr[0].x + 9;
+			spr[1].y = SSD1306_H - 12 - (f * 5) % SSD1306_H;
+			moved &= !ssd1306_sprites_update(&bench_dev, spr, 2) && bench_panel_ok();
+		}
+		check(moved, "sprites moved and sent");
+
+		memcpy(ssd1306_buffer, bg, sizeof(bg));
+		ssd1306_drawPageImage(spr[0].x, spr[0].y, bench_page_img, IMG_W, IMG_H, imagemode_or);
+		ssd1306_drawPageImage(spr[1].x, spr[1].y, bench_page_img, IMG_W, IMG_H, imagemode_xor);
+		memcpy(want, ssd1306_buffer, sizeof(want));
+		ssd1306_sprites_erase(spr, 2);
+		ssd1306_sprites_draw(spr, 2);
+		check(!memcmp(ssd1306_buffer, want, sizeof(want)), "sprites over the background");
+
+		spr[0].image = spr[1].image = NULL;
+		restored = !ssd1306_sprites_update(&bench_dev, spr, 2);
+		check(restored && !memcmp(ssd1306_buffer, bg, sizeof(bg)) && bench_panel_ok(), "sprites hidden, background back");
+	}
+}
+
+#if SSD1306_CANVAS
+/* ============================================================================
+ * CANVASES
+ * ============================================================================ */
+
+// odd sizes, so the stride differs from SSD1306_W and the last page is partial
+#define CANVAS_W (SSD1306_W / 2 + 5)
+#define CANVAS_H (SSD1306_H / 2 + 3)
+#define CANVAS_SIZE SSD1306_CANVAS_SIZE(CANVAS_W, CANVAS_H)
+
+/*
+ * scenes drawn into a canvas, fast against pixel path, then blitted
+ */
+static void check_canvas(void)
+{
+	static uint8_t fast[CANVAS_SIZE], ref[CANVAS_SIZE], want[BENCH_FB_SIZE];
+	ssd1306_canvas_t cf, cr;
+	char what[80];
+
+	ssd1306_canvas_init(&cf, fast, CANVAS_W, CANVAS_H);
+	ssd1306_canvas_init(&cr, ref, CANVAS_W, CANVAS_H);
+	for(uint32_t i = 0; i < BENCH_SCENES; i++)
+	{
+		const bench_scene_t *s = &bench_scenes[i];
+
+		if(!s->pixel_ref)
+			continue;
+		bench_noise(ref, CANVAS_SIZE, i + 1);
+		ssd1306_canvas_begin(&cr);
+		s->draw(&bench_ref);
+		bench_noise(fast, CANVAS_SIZE, i + 1);
+		ssd1306_canvas_begin(&cf);
+		s->draw(&bench_fast);
+		ssd1306_canvas_end();
+
+		snprintf(what, sizeof(what), "%s: canvas fast path differs from pixel path", s->name);
+		check(!memcmp(ref, fast, CANVAS_SIZE), what);
+	}
+
+	{
+		uint8_t any = 0;
+
+		ssd1306_canvas_begin(&cf);
+		ssd1306_setbuf(0);
+		ssd1306_canvas_end();
+		for(uint32_t i = 0; i < CANVAS_SIZE; i++)
+			any |= fast[i];
+		check(!any, "setbuf clears the canvas");
+	}
+
+	bench_background();
+	check(!ssd1306_refresh(&bench_dev), "refresh before blit");
+	for(uint32_t m = imagemode_copy; m <= imagemode_xor; m++)
+	{
+		int32_t x = (int32_t)(m * 29 % SSD1306_W) - 20, y = (int32_t)(m * 9 % SSD1306_H) - 6;
+
+		bench_noise(fast, CANVAS_SIZE, m + 100);
+		bench_background();
+		ref_pageimage(x, y, fast, CANVAS_W, CANVAS_H, m);
+		memcpy(want, ssd1306_buffer, BENCH_FB_SIZE);
+		bench_background();
+		ssd1306_blit(&cf, x, y, m);
+		snprintf(what, sizeof(what), "blit mode %u at %d,%d", m, x, y);
+		check(!memcmp(want, ssd1306_buffer, BENCH_FB_SIZE), what);
+	}
+
+	/* only the blitted area is sent */
+#if SSD1306_DIRTY_TRACKING
+	bench_background();
+	check(!ssd1306_refresh(&bench_dev), "refresh before blit");
+	ssd1306_drawFastHLine(0, 1, SSD1306_W, 1);
+	check(!ssd1306_refresh_dirty(&bench_dev), "refresh_dirty before blit");
+	ssd1306_blit(&cf, 3, 5, imagemode_copy);
+	mock_i2c_reset_counts();
+	check(!ssd1306_refresh_dirty(&bench_dev) && bench_panel_ok() &&
+		mock_i2c.bytes < CANVAS_SIZE + 2 * CANVAS_W + 8 * (CANVAS_H / 8 + 2), "refresh_dirty after blit");
+#endif
+
+	/* canvas into canvas */
+	bench_noise(fast, CANVAS_SIZE, 7);
+	ssd1306_canvas_begin(&cr);
+	ssd1306_setbuf(0);
+	ssd1306_blit(&cf, 0, 0, imagemode_copy);
+	ssd1306_canvas_end();
+	check(!memcmp(ref, fast, CANVAS_W * (CANVAS_H / 8)), "blit into a canvas");
+
+	/* sprites and display lists stay on the frame buffer inside a canvas */
+	{
+		static uint8_t save[SSD1306_SPRITE_SAVE(IMG_W, IMG_H)], keep[CANVAS_SIZE], got[BENCH_FB_SIZE];
+		static ssd1306_dl_op_t ops[4];
+		ssd1306_sprite_t spr;
+		ssd1306_dl_t dl;
+
+		bench_noise(fast, CANVAS_SIZE, 11);
+		memcpy(keep, fast, CANVAS_SIZE);
+		bench_background();
+		memcpy(want, ssd1306_buffer, BENCH_FB_SIZE);
+		ssd1306_sprite_init(&spr, bench_page_img, IMG_W, IMG_H, imagemode_or, save);
+		spr.x = SSD1306_W - IMG_W - 1;
+		spr.y = SSD1306_H - IMG_H - 3;
+		ssd1306_canvas_begin(&cf);
+		ssd1306_sprites_draw(&spr, 1);
+		ssd1306_canvas_end();
+		memcpy(got, ssd1306_buffer, BENCH_FB_SIZE);
+		memcpy(ssd1306_buffer, want, BENCH_FB_SIZE);
+		ssd1306_drawPageImage(spr.x, spr.y, bench_page_img, IMG_W, IMG_H, imagemode_or);
+		check(!memcmp(got, ssd1306_buffer, BENCH_FB_SIZE) && !memcmp(keep, fast, CANVAS_SIZE),
+			"sprites_draw inside a canvas");
+
+		ssd1306_canvas_begin(&cf);
+		ssd1306_sprites_erase(&spr, 1);
+		ssd1306_canvas_end();
+		check(!memcmp(want, ssd1306_buffer, BENCH_FB_SIZE) && !memcmp(keep, fast, CANVAS_SIZE),
+			"sprites_erase inside a canvas");
+
+		ssd1306_dl_init(&dl, ops, 4);
+		ssd1306_dl_begin(&dl);
+		ssd1306_dl_fillRoundRect(&dl, 2, 2, SSD1306_W - 4, SSD1306_H - 4, 6, 1);
+		ssd1306_canvas_begin(&cf);
+		check(!ssd1306_dl_render(&dl, &bench_dev), "dl_render inside a canvas");
+		ssd1306_canvas_end();
+		check(bench_panel_ok() && ssd1306_buffer[SSD1306_W + SSD1306_W / 2] == 0xFF &&
+			!memcmp(keep, fast, CANVAS_SIZE), "dl_render inside a canvas draws the frame buffer");
+	}
+
+#if SSD1306_MULTI
+	{
+		static uint8_t buf2[BENCH_FB_SIZE];
+		ssd1306_disp_t d2, *d1 = ssd1306_selected();
+
+		ssd1306_disp_init(&d2, &bench_dev, buf2);
+		memset(buf2, 0, sizeof(buf2));
+		ssd1306_canvas_begin(&cf);
+		ssd1306_select(&d2);
+		ssd1306_canvas_end();
+		ssd1306_drawPixel(0, 0, 1);
+		check(buf2[0] & 1, "canvas_end goes back to the display selected meanwhile");
+		ssd1306_select(d1);
+	}
+#endif
+}
+#endif
+
+/* ============================================================================
+ * BENCHMARK
+ * ============================================================================ */
+
+typedef struct {
+	const char *name;
+	void (*setup)(void);   // untimed preparation before every run, may be NULL
+	void (*run)(void);     // timed operation
+	uint32_t pixels;       // pixels touched per run
+} bench_case_t;
+
+static ssd1306_dl_op_t bench_ops[8];
+static ssd1306_dl_t bench_dl;
+static uint32_t bench_toggle;
+
+static void bench_pixel(void)      { ssd1306_drawPixel(17, 11, 1); }
+static void bench_hline(void)      { ssd1306_drawFastHLine(0, 11, SSD1306_W, 1); }
+static void bench_vline(void)      { ssd1306_drawFastVLine(17, 0, SSD1306_H, 1); }
+static void bench_fillrect(void)   { ssd1306_fillRect(5, 3, 32, 16, 1); }
+static void bench_xorrect(void)    { ssd1306_xorrect(0, 0, SSD1306_W / 2, SSD1306_H); }
+static void bench_line(void)       { ssd1306_drawLine(0, 0, SSD1306_W - 1, SSD1306_H - 1, 1); }
+static void bench_line_clip(void)  { ssd1306_drawLine(-50, -20, SSD1306_W + 50, SSD1306_H + 20, 1); }
+static void bench_circle(void)     { ssd1306_drawCircle(SSD1306_W / 2, SSD1306_H / 2, 15, 1); }
+static void bench_fillcircle(void) { ssd1306_fillCircle(SSD1306_W / 2, SSD1306_H / 2, 15, 1); }
+static void bench_roundrect(void)  { ssd1306_fillRoundRect(4, 2, 40, 28, 6, 1); }
+static void bench_char(void)       { ssd1306_drawchar(16, 8, 'A', 1); }
+static void bench_char_unal(void)  { ssd1306_drawchar(16, 11, 'A', 1); }
+static void bench_str(void)        { ssd1306_drawstr(0, 8, "0123456789ABCDEF", 1); }
+static void bench_font(void)       { fast_str_font(0, 8, "0123456789ABCDEF", 1); }
+static void bench_char16(void)     { ssd1306_drawchar_sz(0, 0, '8', 1, fontsize_16x16); }
+static void bench_char32(void)     { ssd1306_drawchar_sz(0, 0, '8', 1, fontsize_32x32); }
+static void bench_image(void)      { ssd1306_drawImage(0, 0, bench_row_img, ROW_IMG_W, ROW_IMG_H, imagemode_copy); }
+static void bench_pageimg(void)    { ssd1306_drawPageImage(8, 0, bench_page_img, IMG_W, IMG_H, imagemode_copy); }
+static void bench_pageimg_un(void) { ssd1306_drawPageImage(8, 3, bench_page_img, IMG_W, IMG_H, imagemode_or); }
+static void bench_rleimg(void)     { ssd1306_drawRleImage(8, 3, bench_rle_img, IMG_W, IMG_H, imagemode_or); }
+static void bench_setbuf(void)     { ssd1306_setbuf(0); }
+static void bench_refresh(void)    { ssd1306_refresh(&bench_dev); }
+#if SSD1306_PAGE_HASH || SSD1306_DIRTY_TRACKING || !SSD1306_ROTATE_90
+static void bench_change(void)     { ssd1306_drawchar(64 % SSD1306_W, 8, '0' + (bench_toggle++ & 7), 1); }
+#endif
+#if SSD1306_DIRTY_TRACKING
+static void bench_dirty(void)      { ssd1306_refresh_dirty(&bench_dev); }
+static void bench_step(void)       { while(ssd1306_refresh_pending()) ssd1306_refresh_step(&bench_dev, 40); }
+#endif
+#if !SSD1306_ROTATE_90
+static void bench_rect(void)       { ssd1306_refresh_rect(&bench_dev, 64 % SSD1306_W, 8, 8, 8); }
+static void bench_direct(void)     { ssd1306_drawstr_direct(&bench_dev, 0, 1, "0123456789ABCDEF", 1, 1); }
+static void bench_stream(void)     { ssd1306_streamRleImage(&bench_dev, bench_screen_rle); }
+#endif
+#if SSD1306_STRIP_PAGES
+static void bench_strips(void)     { ssd1306_render_strips(&bench_dev, bench_strip_draw, (void *)&bench_scenes[2]); }
+#endif
+static void bench_dl_frame(void)
+{
+	ssd1306_dl_begin(&bench_dl);
+	ssd1306_dl_fillRoundRect(&bench_dl, 2, 2, SSD1306_W - 4, SSD1306_H - 4, 6, 1);
+	ssd1306_dl_drawstr(&bench_dl, 8, 8, (bench_toggle++ & 1) ? "frame" : "FRAME", 0);
+}
+static void bench_dl_render(void)  { ssd1306_dl_render(&bench_dl, &bench_dev); }
+#if SSD1306_CANVAS
+static uint8_t bench_canvas_buf[CANVAS_SIZE];
+static ssd1306_canvas_t bench_canvas;
+static void bench_blit(void)       { ssd1306_blit(&bench_canvas, 8, 0, imagemode_copy); }
+static void bench_blit_un(void)    { ssd1306_blit(&bench_canvas, 8, 3, imagemode_or); }
+#endif
+static uint8_t bench_spr_save[SSD1306_SPRITE_SAVE(IMG_W, IMG_H)];
+static ssd1306_sprite_t bench_spr[2];
+static void bench_sprites(void)
+{
+	bench_spr[0].x = bench_toggle % (SSD1306_W - IMG_W);
+	bench_spr[1].x = SSD1306_W - IMG_W - bench_spr[0].x;
+	bench_spr[1].y = bench_toggle++ % (SSD1306_H - IMG_H);
+	ssd1306_sprites_update(&bench_dev, bench_spr, 2);
+}
+
+static const bench_case_t bench_cases[] = {
+	{ "drawPixel",     NULL, bench_pixel,      1 },
+	{ "hline",         NULL, bench_hline,      SSD1306_W },
+	{ "vline",         NULL, bench_vline,      SSD1306_H },
+	{ "fillRect",      NULL, bench_fillrect,   32 * 16 },
+	{ "xorrect",       NULL, bench_xorrect,    SSD1306_W / 2 * SSD1306_H },
+	{ "drawLine",      NULL, bench_line,       SSD1306_W },
+	{ "drawLine clip", NULL, bench_line_clip,  SSD1306_W },
+	{ "drawCircle",    NULL, bench_circle,     4 * 15 },
+	{ "fillCircle",    NULL, bench_fillcircle, 707 },
+	{ "fillRoundRect", NULL, bench_roundrect,  40 * 28 },
+	{ "char 8x8",      NULL, bench_char,       64 },
+	{ "char unalgn",   NULL, bench_char_unal,  64 },
+	{ "str 16ch",      NULL, bench_str,        16 * 64 },
+	{ "font 16ch",     NULL, bench_font,       16 * 64 },
+	{ "char 16x16",    NULL, bench_char16,     16 * 16 },
+	{ "char 32x32",    NULL, bench_char32,     32 * 32 },
+	{ "drawImage",     NULL, bench_image,      ROW_IMG_W * ROW_IMG_H },
+	{ "pageImage",     NULL, bench_pageimg,    IMG_W * IMG_H },
+	{ "pageImg unal",  NULL, bench_pageimg_un, IMG_W * IMG_H },
+	{ "rleImage unal", NULL, bench_rleimg,     IMG_W * IMG_H },
+	{ "setbuf",        NULL, bench_setbuf,     SSD1306_W * SSD1306_H },
+	{ "refresh",       NULL, bench_refresh,    SSD1306_W * SSD1306_H },
+#if SSD1306_PAGE_HASH
+	{ "refresh hash",  bench_change, bench_refresh, 64 },
+#endif
+#if SSD1306_DIRTY_TRACKING
+	{ "refresh dirty", bench_change, bench_dirty, 64 },
+	{ "refresh step",  bench_change, bench_step,  64 },
+#endif
+#if !SSD1306_ROTATE_90
+	{ "refresh rect",  bench_change, bench_rect,   64 },
+	{ "str direct",    NULL, bench_direct,     16 * 64 },
+	{ "stream rle",    NULL, bench_stream,     SSD1306_W * SSD1306_H },
+#endif
+#if SSD1306_STRIP_PAGES
+	{ "strips lines",  NULL, bench_strips,     SSD1306_W * SSD1306_H },
+#endif
+	{ "dl render",     bench_dl_frame, bench_dl_render, SSD1306_W * SSD1306_H },
+	{ "sprites 2",     NULL, bench_sprites,    2 * IMG_W * IMG_H },
+#if SSD1306_CANVAS
+	{ "blit",          NULL, bench_blit,       CANVAS_W * CANVAS_H },
+	{ "blit unalgn",   NULL, bench_blit_un,    CANVAS_W * CANVAS_H },
+#endif
+};
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * time every case, in batches where there is no per-run setup
+ */
+static void run_benchmark(void)
+{
+	printf("\n%ux%u, %llu ms per case\n", SSD1306_W, SSD1306_H,
+		(unsigned long long)(BENCH_MIN_NS / 1000000));
+	printf("case               ns/op     Mpx/s  bus B/op  xfer/op\n");
+
+	ssd1306_dl_init(&bench_dl, bench_ops, 8);
+	ssd1306_sprite_init(&bench_spr[0], bench_page_img, IMG_W, IMG_H, imagemode_or, bench_spr_save);
+	ssd1306_sprite_init(&bench_spr[1], bench_page_img, IMG_W, IMG_H, imagemode_xor, NULL);
+#if SSD1306_CANVAS
+	ssd1306_canvas_init(&bench_canvas, bench_canvas_buf, CANVAS_W, CANVAS_H);
+	bench_noise(bench_canvas_buf, CANVAS_SIZE, 0x9E3779B9);
+#endif
+	for(uint32_t c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++)
+	{
+		const bench_case_t *bc = &bench_cases[c];
+		uint32_t batch = bc->setup ? 1 : 64;
+		uint64_t ns = 0, runs = 0, bytes = 0, xfers = 0;
+
+		bench_background();
+		ssd1306_refresh(&bench_dev);
+		while(ns < BENCH_MIN_NS)
+		{
+			if(bc->setup)
+				bc->setup();
+			mock_i2c_reset_counts();
+			uint64_t t0 = bench_now();
+			for(uint32_t i = 0; i < batch; i++)
+				bc->run();
+			ns += bench_now() - t0;
+			bytes += mock_i2c.bytes;
+			xfers += mock_i2c.xfers;
+			runs += batch;
+		}
+
+		double ns_op = (double)ns / runs;
+		printf("%-15s %9.1f %9.1f %9.1f %8.1f\n", bc->name, ns_op,
+			bc->pixels / ns_op * 1000.0, (double)bytes / runs, (double)xfers / runs);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int checks_only = 0, print_golden = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-c"))
+			checks_only = 1;
+		else if(!strcmp(argv[i], "-g"))
+			print_golden = 1;
+		else
+		{
+			fprintf(stderr, "usage: %s [-c] [-g]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	mock_i2c_reset(0);
+	check(!ssd1306_init(&bench_dev), "init");
+	bench_images();
+
+	check_scenes(print_golden);
+	check_refresh();
+#if SSD1306_CANVAS
+	check_canvas();
+#endif
+	if(!checks_only)
+		run_benchmark();
+
+	if(bench_failures)
+		printf("%ux%u: %u checks failed\n", SSD1306_W, SSD1306_H, bench_failures);
+	else
+		printf("%ux%u: all checks passed\n", SSD1306_W, SSD1306_H);
+	return bench_failures != 0;
+}
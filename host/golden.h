@@ -0,0 +1,40 @@
+/* ============================================================================
+ * Golden CRC-32 of the frame buffer after every bench scene, per panel size
+ *
+ * Record a row on a build that draws correctly and paste it here:
+ *
+ *   pio run -e host_128x64 && .pio/build/host_128x64/program -c -g
+ *
+ * Scenes marked text in bench_scenes[] draw with include/font_8x8.h and
+ * are recorded as 0, their CRCs are not checked since they depend on the
+ * font in use. Sizes without a row skip this check, the fast against
+ * pixel path comparison still runs.
+ * ============================================================================ */
+
+static const bench_golden_t bench_golden[] = {
+	{ 64, 32, {
+		0x59931766, 0xe5c2c9a8, 0xde14d1bc, 0x0ab657eb, 0xb0e8c964, 0x1bfcf340,
+		0x6d992e27, 0x3aa78079, 0x69bd25db, 0x00000000, 0x00000000, 0x9619ee75,
+		0x91a64244, 0x91a64244, 0x00000000, 0x00000000, 0x00000000, 0xba699262,
+	} },
+	{ 72, 40, {
+		0x774704cc, 0x8409add6, 0x7e229246, 0x2e1188df, 0x6df885d2, 0x1243fce8,
+		0x5a7cc983, 0x86acf708, 0x7a96e238, 0x00000000, 0x00000000, 0x43c3fa7c,
+		0xa186e0f4, 0xa186e0f4, 0x00000000, 0x00000000, 0x00000000, 0xc6a591fc,
+	} },
+	{ 128, 32, {
+		0x77e39554, 0xeed93a76, 0x9f5d4871, 0x7430a13c, 0xf0409bd9, 0x0f4eac3d,
+		0xfb51d6ae, 0x87eb3771, 0x39807d83, 0x00000000, 0x00000000, 0xa47423ea,
+		0x18ad672d, 0x18ad672d, 0x00000000, 0x00000000, 0x00000000, 0x4ce5618d,
+	} },
+	{ 128, 64, {
+		0xd5c3ae2a, 0x7beb99df, 0x9a8059bd, 0x3f0c9911, 0x318b0f76, 0x0eecbc45,
+		0x554d65ca, 0xa6e7e6fc, 0x26f7340e, 0x00000000, 0x00000000, 0x560ebc44,
+		0x53724e1e, 0x53724e1e, 0x00000000, 0x00000000, 0x00000000, 0x31f4efd1,
+	} },
+	{ 128, 128, {
+		0x0b3858ae, 0x55615dcc, 0x9b02f02f, 0xa2063aae, 0x4681733d, 0x3e8a355b,
+		0xe12e5846, 0xcd3e21fe, 0x561cd6a3, 0x00000000, 0x00000000, 0xb2e72e38,
+		0x1b77dbde, 0x1b77dbde, 0x00000000, 0x00000000, 0x00000000, 0x0af838fc,
+	} },
+};
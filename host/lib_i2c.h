@@ -0,0 +1,56 @@
+/* ============================================================================
+ * Host stand-in for CH32V003_lib_i2c
+ *
+ * Same types and calls as the real library, so myssd1306.c builds unchanged
+ * on a PC. The transactions end up in host/mock_i2c.c, which counts them and
+ * keeps a model of the controller RAM, see mock_i2c.h.
+ * ============================================================================ */
+
+#ifndef LIB_I2C_H
+#define LIB_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum {
+	I2C_OK = 0,
+	I2C_ERR_BERR,
+	I2C_ERR_NACK,
+	I2C_ERR_ARLO,
+	I2C_ERR_OVR,
+	I2C_ERR_BUSY,
+} i2c_err_t;
+
+typedef enum {
+	I2C_CLK_10KHZ  = 10000,
+	I2C_CLK_50KHZ  = 50000,
+	I2C_CLK_100KHZ = 100000,
+	I2C_CLK_400KHZ = 400000,
+	I2C_CLK_500KHZ = 500000,
+	I2C_CLK_600KHZ = 600000,
+	I2C_CLK_750KHZ = 750000,
+	I2C_CLK_1MHZ   = 1000000,
+} i2c_clkr_t;
+
+typedef enum {
+	I2C_ADDR_7BIT = 0,
+	I2C_ADDR_10BIT,
+} i2c_addr_t;
+
+typedef struct {
+	uint32_t   clkr;
+	i2c_addr_t type;
+	uint16_t   addr;
+	uint8_t    regb;
+	uint32_t   tout;
+} i2c_device_t;
+
+i2c_err_t i2c_init(const i2c_device_t *dev);
+i2c_err_t i2c_ping(const uint8_t addr);
+i2c_err_t i2c_write_raw(const i2c_device_t *dev, const uint8_t *buf, const size_t len);
+i2c_err_t i2c_write_reg(const i2c_device_t *dev, const uint32_t reg, const uint8_t *buf, const size_t len);
+i2c_err_t i2c_read_raw(const i2c_device_t *dev, uint8_t *buf, const size_t len);
+i2c_err_t i2c_read_reg(const i2c_device_t *dev, const uint32_t reg, uint8_t *buf, const size_t len);
+
+#endif
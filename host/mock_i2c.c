@@ -0,0 +1,218 @@
+/* ============================================================================
+ * Mock I2C bus with an SSD1306/SH1107 controller model for host builds
+ *
+ * Models what the driver relies on: horizontal addressing inside the
+ * column/page window set by 0x21/0x22, wrapping back to the window start,
+ * and the display start line (0x40 | line, or 0xDC line on SH1107).
+ * Segment remap and COM scan direction are accepted but not modelled, the
+ * panel read back is always in init orientation.
+ * ============================================================================ */
+
+#include <string.h>
+#include "myssd1306.h"
+#include "mock_i2c.h"
+
+mock_i2c_t mock_i2c;
+uint8_t mock_ram[MOCK_RAM_PAGES][MOCK_RAM_W];
+void (*mock_i2c_trace)(uint16_t addr, const uint8_t *buf, size_t len);
+
+// controller state
+static uint32_t mock_c0, mock_c1, mock_p0, mock_p1, mock_col, mock_page, mock_line;
+
+// command bytes being collected
+static uint8_t mock_cmd[8];
+static uint32_t mock_ncmd, mock_need;
+
+/*
+ * total length of the command starting with byte c
+ */
+static uint32_t mock_cmd_len(uint8_t c)
+{
+	switch(c)
+	{
+		case SSD1306_COLUMNADDR:
+		case SSD1306_PAGEADDR:
+		case SSD1306_SET_VERTICAL_SCROLL_AREA:
+			return 3;
+		case SSD1306_RIGHT_HORIZONTAL_SCROLL:
+		case SSD1306_LEFT_HORIZONTAL_SCROLL:
+			return 7;
+		case SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL:
+		case SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL:
+			return 6;
+		case SSD1306_SETCONTRAST:
+		case SSD1306_SETMULTIPLEX:
+		case SSD1306_SETDISPLAYOFFSET:
+		case SSD1306_SETDISPLAYCLOCKDIV:
+		case SSD1306_SETPRECHARGE:
+		case SSD1306_SETCOMPINS:
+		case SSD1306_SETVCOMDETECT:
+		case SSD1306_CHARGEPUMP:
+		case SSD1306_MEMORYMODE:
+		case 0xAD:               // SH1107 charge pump
+		case SH1107_SETSTARTLINE:
+			return 2;
+		default:
+			return 1;
+	}
+}
+
+/*
+ * act on a complete command
+ */
+static void mock_command(void)
+{
+	uint8_t c = mock_cmd[0];
+
+	if(c == SSD1306_COLUMNADDR)
+	{
+		mock_c0 = mock_cmd[1] % MOCK_RAM_W;
+		mock_c1 = mock_cmd[2] % MOCK_RAM_W;
+		mock_col = mock_c0;
+	}
+	else if(c == SSD1306_PAGEADDR)
+	{
+		mock_p0 = mock_cmd[1] % MOCK_RAM_PAGES;
+		mock_p1 = mock_cmd[2] % MOCK_RAM_PAGES;
+		mock_page = mock_p0;
+	}
+	else if(c == SH1107_SETSTARTLINE)
+		mock_line = mock_cmd[1];
+	else if((c & 0xC0) == SSD1306_SETSTARTLINE)
+		mock_line = c & 0x3F;
+}
+
+static void mock_cmd_byte(uint8_t b)
+{
+	mock_cmd[mock_ncmd++] = b;
+	if(mock_ncmd == 1)
+		mock_need = mock_cmd_len(b);
+	if(mock_ncmd == mock_need)
+	{
+		mock_command();
+		mock_ncmd = 0;
+	}
+}
+
+static void mock_data_byte(uint8_t b)
+{
+	mock_ram[mock_page][mock_col] = b;
+	if(mock_col == mock_c1)
+	{
+		mock_col = mock_c0;
+		mock_page = (mock_page == mock_p1) ? mock_p0 : (mock_page + 1) % MOCK_RAM_PAGES;
+	}
+	else
+		mock_col = (mock_col + 1) % MOCK_RAM_W;
+}
+
+void mock_i2c_reset_counts(void)
+{
+	uint32_t fail_every = mock_i2c.fail_every, max_clk = mock_i2c.max_clk, clk = mock_i2c.clk;
+
+	memset(&mock_i2c, 0, sizeof(mock_i2c));
+	mock_i2c.fail_every = fail_every;
+	mock_i2c.max_clk = max_clk;
+	mock_i2c.clk = clk;
+}
+
+void mock_i2c_reset(uint8_t fill)
+{
+	mock_i2c_reset_counts();
+	memset(mock_ram, fill, sizeof(mock_ram));
+	mock_c0 = mock_p0 = mock_col = mock_page = mock_line = 0;
+	mock_c1 = MOCK_RAM_W - 1;
+	mock_p1 = MOCK_RAM_PAGES - 1;
+	mock_ncmd = 0;
+}
+
+uint32_t mock_start_line(void)
+{
+	return mock_line;
+}
+
+uint8_t mock_panel_pixel(uint32_t x, uint32_t y)
+{
+	uint32_t row = (y + mock_line) % (8 * SSD1306_RAM_PAGES);
+
+	return (mock_ram[row / 8][(SSD1306_OFFSET + x) % MOCK_RAM_W] >> (row & 7)) & 1;
+}
+
+/* ============================================================================
+ * lib_i2c API
+ * ============================================================================ */
+
+i2c_err_t i2c_init(const i2c_device_t *dev)
+{
+	mock_i2c.clk = dev->clkr;
+	return I2C_OK;
+}
+
+i2c_err_t i2c_ping(const uint8_t addr)
+{
+	(void)addr;
+	return I2C_OK;
+}
+
+/*
+ * first byte is the SSD1306 control byte: 0x00 commands, 0x40 data,
+ * 0x80 a single command
+ */
+i2c_err_t i2c_write_raw(const i2c_device_t *dev, const uint8_t *buf, const size_t len)
+{
+	size_t i;
+
+	if(mock_i2c_trace)
+		mock_i2c_trace(dev->addr, buf, len);
+	mock_i2c.xfers++;
+	mock_i2c.bytes += len + 1;
+	if(len && buf[0] == 0x40)
+		mock_i2c.data_xfers++;
+	else
+		mock_i2c.cmd_xfers++;
+	if((mock_i2c.fail_every && mock_i2c.xfers % mock_i2c.fail_every == 0) ||
+		(mock_i2c.max_clk && mock_i2c.clk > mock_i2c.max_clk))
+	{
+		mock_i2c.naks++;
+		return I2C_ERR_NACK;
+	}
+	if(!len)
+		return I2C_OK;
+
+	if(buf[0] == 0x40)
+		for(i = 1; i < len; i++)
+			mock_data_byte(buf[i]);
+	else if(buf[0] == 0x80)
+	{
+		if(len > 1)
+			mock_cmd_byte(buf[1]);
+	}
+	else
+		for(i = 1; i < len; i++)
+			mock_cmd_byte(buf[i]);
+	return I2C_OK;
+}
+
+i2c_err_t i2c_write_reg(const i2c_device_t *dev, const uint32_t reg, const uint8_t *buf, const size_t len)
+{
+	uint8_t pkt[1 + MOCK_RAM_PAGES * MOCK_RAM_W];
+
+	if(len >= sizeof(pkt))
+		return I2C_ERR_OVR;
+	pkt[0] = (uint8_t)reg;
+	memcpy(&pkt[1], buf, len);
+	return i2c_write_raw(dev, pkt, len + 1);
+}
+
+i2c_err_t i2c_read_raw(const i2c_device_t *dev, uint8_t *buf, const size_t len)
+{
+	(void)dev;
+	memset(buf, 0, len);
+	return I2C_OK;
+}
+
+i2c_err_t i2c_read_reg(const i2c_device_t *dev, const uint32_t reg, uint8_t *buf, const size_t len)
+{
+	(void)reg;
+	return i2c_read_raw(dev, buf, len);
+}
@@ -0,0 +1,63 @@
+/* ============================================================================
+ * Mock I2C bus with an SSD1306/SH1107 controller model for host builds
+ *
+ * Every transaction the driver sends is counted and fed into a model of
+ * the controller: command parsing, column/page address window, horizontal
+ * addressing and the display start line. What the panel would show can be
+ * read back with mock_panel_pixel().
+ * ============================================================================ */
+
+#ifndef _MOCK_I2C_H
+#define _MOCK_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Columns and pages of controller RAM (SH1107 has 16 pages)
+#define MOCK_RAM_W 128
+#define MOCK_RAM_PAGES 16
+
+typedef struct {
+	uint32_t xfers;       // write transactions, failed ones included
+	uint32_t cmd_xfers;   // transactions with control byte 0x00 / 0x80
+	uint32_t data_xfers;  // transactions with control byte 0x40
+	uint32_t bytes;       // bus bytes: address, control and payload
+	uint32_t naks;        // transactions answered with I2C_ERR_NACK
+	uint32_t fail_every;  // NACK every n-th transaction, 0 = never
+	uint32_t max_clk;     // NACK everything sent faster than this, 0 = any clock
+	uint32_t clk;         // clock of the last i2c_init()
+} mock_i2c_t;
+
+extern mock_i2c_t mock_i2c;
+
+// Controller RAM, bit 0 of each byte is the top row of the page
+extern uint8_t mock_ram[MOCK_RAM_PAGES][MOCK_RAM_W];
+
+// Called with every transaction before it is modelled, may be NULL
+extern void (*mock_i2c_trace)(uint16_t addr, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Clear the counters, keep RAM and controller state
+ */
+void mock_i2c_reset_counts(void);
+
+/**
+ * @brief Power-on state: RAM filled with a pattern, full window, start line 0
+ * @param fill Byte written to every RAM location
+ */
+void mock_i2c_reset(uint8_t fill);
+
+/**
+ * @brief Display start line last set by the driver
+ */
+uint32_t mock_start_line(void);
+
+/**
+ * @brief Pixel the panel shows at panel coordinates x, y
+ * @param x Panel column, 0 to SSD1306_PANEL_W-1
+ * @param y Panel row, 0 to SSD1306_PANEL_H-1
+ * @return 1 when lit
+ */
+uint8_t mock_panel_pixel(uint32_t x, uint32_t y);
+
+#endif
@@ -7,6 +7,7 @@
 #define I2C_PINOUT_DEFAULT
 // #define I2C_PINOUT_ALT_1
 // #define I2C_PINOUT_ALT_2
+// #define LCD_BENCHMARK 1                 // Run the primitive/refresh benchmark in lcd_example.c instead of the demo
 
 // #define FUNCONF_USE_PLL 1               // Use built-in 2x PLL 
 // #define FUNCONF_USE_HSI 1               // Use HSI Internal Oscillator
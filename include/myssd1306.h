@@ -28,43 +28,195 @@
 // Let the caller configure the OLED dimensions
 #else
 // Standard display configurations - one must be defined
-#if !defined (SSD1306_64X32) && !defined (SSD1306_72X40) && !defined (SSD1306_128X32) && !defined (SSD1306_128X64) && !defined (SH1107_128x128) && !(defined(SSD1306_W) && defined(SSD1306_H) && defined(SSD1306_OFFSET) )
+#if !defined (SSD1306_64X32) && !defined (SSD1306_72X40) && !defined (SSD1306_128X32) && !defined (SSD1306_128X64) && !defined (SH1107_128x128) && !(defined(SSD1306_W) && defined(SSD1306_H) && defined(SSD1306_OFFSET) ) && !(defined(SSD1306_PANEL_W) && defined(SSD1306_PANEL_H) && defined(SSD1306_OFFSET) )
 	#error "Please define the SSD1306_WXH resolution used in your application"
 #endif
 
 #ifdef SSD1306_64X32
-#define SSD1306_W 64
-#define SSD1306_H 32
+#define SSD1306_PANEL_W 64
+#define SSD1306_PANEL_H 32
 #define SSD1306_OFFSET 32
 #endif
 
 #ifdef SSD1306_72X40
-#define SSD1306_W 72
-#define SSD1306_H 40
+#define SSD1306_PANEL_W 72
+#define SSD1306_PANEL_H 40
 #define SSD1306_OFFSET 28
 #endif
 
 #ifdef SSD1306_128X32
-#define SSD1306_W 128
-#define SSD1306_H 32
+#define SSD1306_PANEL_W 128
+#define SSD1306_PANEL_H 32
 #define SSD1306_OFFSET 0
 #endif
 
 #ifdef SSD1306_128X64
-#define SSD1306_W 128
-#define SSD1306_H 64
+#define SSD1306_PANEL_W 128
+#define SSD1306_PANEL_H 64
 #define SSD1306_OFFSET 0
 #endif
 
 #ifdef SH1107_128x128
 #define SH1107
-#define SSD1306_W 128
-#define SSD1306_H 128
+#define SSD1306_PANEL_W 128
+#define SSD1306_PANEL_H 128
 #define SSD1306_OFFSET 0
 #endif
 
 #endif
 
+// Draw on the panel turned by 90 degrees clockwise: the buffer is
+// SSD1306_PANEL_H wide and SSD1306_PANEL_W tall and ssd1306_refresh()
+// transposes it on the way out
+#ifndef SSD1306_ROTATE_90
+#define SSD1306_ROTATE_90 0
+#endif
+
+// Panel geometry as wired (SSD1306_PANEL_W x SSD1306_PANEL_H) and drawing
+// geometry (SSD1306_W x SSD1306_H), the same unless SSD1306_ROTATE_90 is set
+#if !defined(SSD1306_PANEL_W)
+#if SSD1306_ROTATE_90
+	#error "SSD1306_ROTATE_90 needs the panel given as SSD1306_PANEL_W/H"
+#endif
+#define SSD1306_PANEL_W SSD1306_W
+#define SSD1306_PANEL_H SSD1306_H
+#elif SSD1306_ROTATE_90
+#define SSD1306_W SSD1306_PANEL_H
+#define SSD1306_H SSD1306_PANEL_W
+#else
+#define SSD1306_W SSD1306_PANEL_W
+#define SSD1306_H SSD1306_PANEL_H
+#endif
+
+// Number of 8-pixel tall pages in the display buffer and on the panel
+#define SSD1306_PAGES (SSD1306_H / 8)
+#define SSD1306_PANEL_PAGES (SSD1306_PANEL_H / 8)
+
+// Number of pages in controller RAM, the start line wraps around these
+#ifdef SH1107
+#define SSD1306_RAM_PAGES 16
+#else
+#define SSD1306_RAM_PAGES 8
+#endif
+
+// Maximum data bytes per I2C transaction in ssd1306_data_stream(), the bus
+// is released between bursts so other devices can be interleaved
+#ifndef SSD1306_BURST
+#define SSD1306_BURST SSD1306_W
+#endif
+
+// Keep a full frame buffer (ssd1306_buffer) in RAM; set to 0 together with
+// SSD1306_STRIP_PAGES to render through ssd1306_render_strips() only
+#ifndef SSD1306_FRAMEBUFFER
+#define SSD1306_FRAMEBUFFER 1
+#endif
+
+// Height in pages of the strip buffer used by ssd1306_render_strips(),
+// 0 disables strip rendering
+#ifndef SSD1306_STRIP_PAGES
+#define SSD1306_STRIP_PAGES 0
+#endif
+
+#if !SSD1306_FRAMEBUFFER && !SSD1306_STRIP_PAGES
+	#error "SSD1306_FRAMEBUFFER=0 requires SSD1306_STRIP_PAGES"
+#endif
+
+// Track modified columns per page so ssd1306_refresh_dirty() only sends
+// what changed (costs 2 bytes of RAM per page, set to 0 to compile out)
+#ifndef SSD1306_DIRTY_TRACKING
+#define SSD1306_DIRTY_TRACKING (SSD1306_FRAMEBUFFER && !SSD1306_ROTATE_90)
+#endif
+
+// Stream the frame buffer through DMA1 channel 6 (I2C1 TX) with
+// ssd1306_refresh_start(); claims DMA1_Channel6_IRQHandler
+#ifndef SSD1306_USE_DMA
+#define SSD1306_USE_DMA 0
+#endif
+
+// Send transactions queued with ssd1306_queue_*() from the I2C1 event
+// interrupt instead of polling; claims I2C1_EV_IRQHandler and
+// I2C1_ER_IRQHandler, data goes out by DMA when SSD1306_USE_DMA is set
+#ifndef SSD1306_USE_IRQ
+#define SSD1306_USE_IRQ 0
+#endif
+
+// Descriptors in the transmit queue ring, a power of two
+#ifndef SSD1306_QUEUE_LEN
+#define SSD1306_QUEUE_LEN 8
+#endif
+
+#if SSD1306_USE_IRQ && (SSD1306_QUEUE_LEN & (SSD1306_QUEUE_LEN-1))
+	#error "SSD1306_QUEUE_LEN must be a power of two"
+#endif
+
+// Raise the I2C clock with ssd1306_clock_calibrate() and step it down
+// again when blocking transactions keep failing; rewrites dev->clkr
+// and re-runs i2c_init(), so the whole bus changes speed
+#ifndef SSD1306_CLOCK_ADAPT
+#define SSD1306_CLOCK_ADAPT 0
+#endif
+
+// Consecutive failed transactions that drop the clock by one step
+#ifndef SSD1306_CLOCK_FALLBACK
+#define SSD1306_CLOCK_FALLBACK 3
+#endif
+
+// Test transactions sent at every clock step by ssd1306_clock_calibrate()
+#ifndef SSD1306_CLOCK_TRIES
+#define SSD1306_CLOCK_TRIES 16
+#endif
+
+// Keep a hash of every page as last sent so ssd1306_refresh() skips pages
+// whose content did not change (costs 4 bytes of RAM per page)
+#ifndef SSD1306_PAGE_HASH
+#define SSD1306_PAGE_HASH 0
+#endif
+
+// Text console writing controller RAM directly, one page row per text
+// line (costs SSD1306_W bytes of RAM for the line being built)
+#ifndef SSD1306_CONSOLE
+#define SSD1306_CONSOLE 0
+#endif
+
+// Drive several panels of the same geometry through display contexts
+// (ssd1306_disp_t); drawing and refresh act on the selected one
+#ifndef SSD1306_MULTI
+#define SSD1306_MULTI 0
+#endif
+
+#if SSD1306_MULTI && !SSD1306_FRAMEBUFFER
+	#error "SSD1306_MULTI needs SSD1306_FRAMEBUFFER"
+#endif
+
+// Off-screen canvases in page format: ssd1306_canvas_begin() points all
+// drawing at one and ssd1306_blit() blends it into the current target
+// (the target width becomes a variable instead of SSD1306_W)
+#ifndef SSD1306_CANVAS
+#define SSD1306_CANVAS 0
+#endif
+
+// Count transactions, bytes, errors and frames in ssd1306_stats
+#ifndef SSD1306_STATS
+#define SSD1306_STATS 0
+#endif
+
+// Also accumulate SysTick ticks spent in I2C and in driver-run rendering
+#ifndef SSD1306_STATS_TIMING
+#define SSD1306_STATS_TIMING 0
+#endif
+
+#if SSD1306_STATS_TIMING && !SSD1306_STATS
+	#error "SSD1306_STATS_TIMING needs SSD1306_STATS"
+#endif
+
+#if !SSD1306_FRAMEBUFFER && (SSD1306_DIRTY_TRACKING || SSD1306_USE_DMA || SSD1306_PAGE_HASH)
+	#error "SSD1306_DIRTY_TRACKING, SSD1306_USE_DMA and SSD1306_PAGE_HASH need SSD1306_FRAMEBUFFER"
+#endif
+
+#if SSD1306_ROTATE_90 && (!SSD1306_FRAMEBUFFER || SSD1306_STRIP_PAGES || SSD1306_DIRTY_TRACKING || SSD1306_USE_DMA || SSD1306_USE_IRQ || SSD1306_PAGE_HASH || SSD1306_CONSOLE)
+	#error "SSD1306_ROTATE_90 only supports full frame buffer refresh"
+#endif
+
 /* ============================================================================
  * SSD1306 COMMAND DEFINITIONS
  * ============================================================================ */
@@ -76,6 +228,7 @@
 #define SSD1306_INVERTDISPLAY       0xA7  // Inverted display mode
 #define SSD1306_DISPLAYALLON_RESUME 0xA4  // Resume display from RAM
 #define SSD1306_DISPLAYALLON        0xA5  // Entire display on
+#define SSD1306_NOP                 0xE3  // No operation
 
 // Contrast and brightness
 #define SSD1306_SETCONTRAST         0x81  // Set contrast control
@@ -88,6 +241,16 @@
 #define SSD1306_SETHIGHCOLUMN       0x10  // Set higher column start address
 #define SSD1306_SETSTARTLINE        0x40  // Set start line address
 
+// Scrolling (not available on SH1107)
+#define SSD1306_RIGHT_HORIZONTAL_SCROLL              0x26  // Continuous right scroll setup
+#define SSD1306_LEFT_HORIZONTAL_SCROLL               0x27  // Continuous left scroll setup
+#define SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL 0x29  // Diagonal right scroll setup
+#define SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL  0x2A  // Diagonal left scroll setup
+#define SSD1306_DEACTIVATE_SCROLL                    0x2E  // Stop scrolling
+#define SSD1306_ACTIVATE_SCROLL                      0x2F  // Start scrolling
+#define SSD1306_SET_VERTICAL_SCROLL_AREA             0xA3  // Set vertical scroll area
+#define SH1107_SETSTARTLINE                          0xDC  // Set start line (SH1107, 2 bytes)
+
 // Hardware configuration
 #define SSD1306_SEGREMAP            0xA0  // Set segment re-map
 #define SSD1306_SETMULTIPLEX        0xA8  // Set multiplex ratio
@@ -123,11 +286,96 @@ typedef enum {
     fontsize_64x64 = 8,  // 64x64 pixel characters (8x scale)
 } font_size_t;
 
+/* ============================================================================
+ * FONT DESCRIPTOR
+ * ============================================================================ */
+
+// Bitmap font for ssd1306_drawstr_font(), generate with tools/font2c.py.
+// Glyphs first..last are stored one after another as page-format images
+// ((height+7)/8 pages of glyph width bytes, bit 0 = top row)
+typedef struct {
+    const uint8_t *bitmap;    // glyph images
+    const uint16_t *offset;   // start of each glyph in bitmap, NULL if fixed width
+    const uint8_t *width;     // width of each glyph (0 = not in font), NULL if fixed
+    uint8_t first, last;      // character codes covered
+    uint8_t height;           // glyph height in pixels
+    uint8_t fixed;            // glyph width when width is NULL
+    uint8_t spacing;          // blank columns after each glyph
+} ssd1306_font_t;
+
+/* ============================================================================
+ * IMAGE BLEND MODE ENUMERATION
+ * ============================================================================ */
+
+typedef enum {
+    imagemode_copy   = 0,  // write pixels as they are
+    imagemode_invert = 1,  // write pixels after inversion
+    imagemode_and    = 2,  // 0 clears pixel
+    imagemode_or     = 3,  // 1 sets pixel
+    imagemode_ornot  = 4,  // 0 sets pixel
+    imagemode_andnot = 5,  // 1 clears pixel
+    imagemode_xor    = 6,  // 1 toggles pixel
+} image_mode_t;
+
+/* ============================================================================
+ * DRIVER STATISTICS
+ * ============================================================================ */
+
+#if SSD1306_STATS
+typedef struct {
+    uint32_t cmd_xfers;     // command transactions
+    uint32_t data_xfers;    // data transactions (a DMA refresh counts as one)
+    uint32_t bytes;         // bytes on the bus, including address and control bytes
+    uint32_t errors;        // failed transactions
+    uint32_t nacks;         // ... of which not acknowledged
+    uint32_t timeouts;      // ... of which timed out on a busy bus
+    uint32_t frames;        // completed refreshes of any kind
+    uint32_t clock_drops;   // clock steps given up after repeated errors (SSD1306_CLOCK_ADAPT)
+    uint32_t i2c_ticks;     // SysTick ticks in blocking I2C (SSD1306_STATS_TIMING)
+    uint32_t render_ticks;  // SysTick ticks in strip and display list rendering (SSD1306_STATS_TIMING)
+} ssd1306_stats_t;
+#endif
+
+/* ============================================================================
+ * DISPLAY CONTEXT
+ * ============================================================================ */
+
+#if SSD1306_MULTI
+typedef struct {
+    i2c_device_t *dev;                   // bus device of this panel
+    uint8_t *buf;                        // SSD1306_W * SSD1306_H / 8 byte frame buffer
+#if SSD1306_DIRTY_TRACKING
+    uint8_t dirty_x0[SSD1306_PAGES];     // modified column range per page
+    uint8_t dirty_x1[SSD1306_PAGES];
+    uint8_t pkt_page;                    // where the next scheduler packet starts
+#endif
+#if SSD1306_PAGE_HASH
+    uint32_t page_hash[SSD1306_PAGES];   // hash of every page as last sent
+    uint32_t hash_valid;
+#endif
+    uint8_t start_line;                  // RAM row on the top display line
+} ssd1306_disp_t;
+#endif
+
 /* ============================================================================
  * EXTERNAL VARIABLES
  * ============================================================================ */
 
+#if SSD1306_FRAMEBUFFER
 extern uint8_t ssd1306_buffer[SSD1306_W * SSD1306_H / 8];  // Display buffer
+#endif
+
+#if SSD1306_MULTI
+extern ssd1306_disp_t ssd1306_disp0;   // Default display, owns ssd1306_buffer
+#endif
+
+#if SSD1306_STATS
+extern ssd1306_stats_t ssd1306_stats;  // Driver statistics, updated as it runs
+#endif
+
+#ifdef SSD1306_FONT_CM
+extern const ssd1306_font_t ssd1306_font8x8;  // Built-in font as a descriptor
+#endif
 
 /* ============================================================================
  * INITIALIZATION AND CONTROL FUNCTIONS
@@ -145,6 +393,32 @@ uint8_t ssd1306_init(i2c_device_t *dev);
  */
 void ssd1306_rst(void);
 
+#if SSD1306_STATS
+/**
+ * @brief Zero all driver statistics
+ */
+void ssd1306_stats_reset(void);
+#endif
+
+#if SSD1306_CLOCK_ADAPT
+/**
+ * @brief Find the fastest I2C clock the display runs at without errors
+ * @param dev I2C device structure pointer, dev->clkr is the known good
+ *        starting rate and receives the result
+ * @param max_hz Highest clock to try, e.g. I2C_CLK_1MHZ
+ * @return The clock settled on, in Hz
+ * @note Steps through 400, 500, 600, 750 kHz and 1 MHz above the starting
+ *       rate, sending SSD1306_CLOCK_TRIES NOP command transactions at each
+ *       step, and keeps the last step where all of them succeeded. The
+ *       SSD1306 cannot be read over I2C, so only NACKs, bus errors and
+ *       timeouts show a rate is too fast. Call it before ssd1306_init()
+ *       so a corrupted test command is overwritten by the init sequence.
+ *       Afterwards SSD1306_CLOCK_FALLBACK failed transactions in a row
+ *       drop the clock one step, never below the starting rate
+ */
+uint32_t ssd1306_clock_calibrate(i2c_device_t *dev, uint32_t max_hz);
+#endif
+
 /**
  * @brief Send command to display
  * @param dev I2C device structure pointer
@@ -153,6 +427,33 @@ void ssd1306_rst(void);
  */
 uint8_t ssd1306_cmd(i2c_device_t *dev, uint8_t cmd);
 
+/**
+ * @brief Send a list of commands to display in a single transaction
+ * @param dev I2C device structure pointer
+ * @param cmds Command bytes (including their arguments)
+ * @param sz Number of command bytes
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_cmds(i2c_device_t *dev, const uint8_t *cmds, int sz);
+
+// Orientation flags for ssd1306_set_orientation(), relative to the panel
+#define SSD1306_MIRROR_X   1  // Flip columns (segment remap)
+#define SSD1306_MIRROR_Y   2  // Flip rows (COM scan direction)
+#define SSD1306_ROTATE_180 (SSD1306_MIRROR_X | SSD1306_MIRROR_Y)
+
+/**
+ * @brief Mirror or turn the picture by 180 degrees in the controller
+ * @param dev I2C device structure pointer
+ * @param flags SSD1306_MIRROR_X, SSD1306_MIRROR_Y or SSD1306_ROTATE_180,
+ *        0 restores the orientation set by ssd1306_init()
+ * @return 0 on success, non-zero on error
+ * @note Costs nothing per frame, the buffer layout does not change. The
+ *       SSD1306 remaps segments only for data written afterwards so the
+ *       whole frame is marked for sending again. Together with
+ *       SSD1306_ROTATE_90, SSD1306_ROTATE_180 gives 270 degrees
+ */
+uint8_t ssd1306_set_orientation(i2c_device_t *dev, uint8_t flags);
+
 /**
  * @brief Send data to display
  * @param dev I2C device structure pointer
@@ -162,21 +463,345 @@ uint8_t ssd1306_cmd(i2c_device_t *dev, uint8_t cmd);
  */
 uint8_t ssd1306_data(i2c_device_t *dev, uint8_t *data, int sz);
 
+/**
+ * @brief Stream data to display without copying, in SSD1306_BURST sized transactions
+ * @param dev I2C device structure pointer
+ * @param data Data buffer to send
+ * @param sz Size of data buffer (any length)
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_data_stream(i2c_device_t *dev, const uint8_t *data, uint32_t sz);
+
 /* ============================================================================
  * BUFFER MANAGEMENT FUNCTIONS
  * ============================================================================ */
 
 /**
- * @brief Clear or fill entire display buffer
+ * @brief Clear or fill entire display buffer (the current strip while strip rendering)
  * @param color 0 for black (clear), 1 for white (fill)
  */
 void ssd1306_setbuf(uint8_t color);
 
+/**
+ * @brief Clear or fill a rectangular region of the display buffer
+ * @param x Starting X coordinate (clipped, may be negative)
+ * @param y Starting Y coordinate (clipped, may be negative)
+ * @param w Width in pixels
+ * @param h Height in pixels
+ * @param color 0 for black (clear), 1 for white (fill)
+ */
+void ssd1306_setbuf_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t color);
+
+#if SSD1306_FRAMEBUFFER
 /**
  * @brief Refresh display from buffer
  * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero on error
+ * @note With SSD1306_PAGE_HASH only pages that changed since they were last
+ *       sent are transmitted
+ */
+uint8_t ssd1306_refresh(i2c_device_t *dev);
+
+#if !SSD1306_ROTATE_90
+/**
+ * @brief Refresh only the pages covering a rectangle of the buffer
+ * @param dev I2C device structure pointer
+ * @param x Rectangle X coordinate (clipped, may be negative)
+ * @param y Rectangle Y coordinate (clipped, may be negative)
+ * @param w Rectangle width
+ * @param h Rectangle height
+ * @return 0 on success, non-zero on error
+ * @note y and h are rounded out to whole pages; the address window is
+ *       set once and w bytes are sent per page
+ */
+uint8_t ssd1306_refresh_rect(i2c_device_t *dev, int32_t x, int32_t y, int32_t w, int32_t h);
+#endif
+#endif
+
+#if SSD1306_PAGE_HASH
+/**
+ * @brief Forget the page hashes so the next refresh sends every page
+ *        (e.g. after the panel lost power or was written by other means)
+ */
+void ssd1306_refresh_invalidate(void);
+#endif
+
+#if SSD1306_DIRTY_TRACKING
+/**
+ * @brief Refresh only the buffer regions modified since the last refresh
+ * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero on error (failed spans stay modified)
+ */
+uint8_t ssd1306_refresh_dirty(i2c_device_t *dev);
+
+/**
+ * @brief Mark a buffer region as modified (for code writing ssd1306_buffer directly)
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width in pixels
+ * @param h Height in pixels
+ */
+void ssd1306_mark_dirty(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+/**
+ * @brief Check whether modified regions are waiting to be sent
+ * @return non-zero if a dirty refresh would send anything
+ */
+uint8_t ssd1306_refresh_pending(void);
+
+/**
+ * @brief Send the next packets of the modified regions within a byte budget
+ * @param dev I2C device structure pointer
+ * @param budget Bus bytes allowed for this call (address, control and window bytes included)
+ * @return 0 on success, non-zero if a packet failed (it stays pending)
+ * @note Call every main loop pass until ssd1306_refresh_pending() returns 0;
+ *       the bus is released between packets, at least one packet is sent
+ */
+uint8_t ssd1306_refresh_step(i2c_device_t *dev, uint32_t budget);
+
+/**
+ * @brief Like ssd1306_refresh_step() with the budget in microseconds of bus time
+ * @param dev I2C device structure pointer
+ * @param us Bus time allowed at the device's nominal clock
+ * @return 0 on success, non-zero if a packet failed (it stays pending)
+ */
+uint8_t ssd1306_refresh_step_us(i2c_device_t *dev, uint32_t us);
+#endif
+
+#if SSD1306_MULTI
+/**
+ * @brief Set up a display context for another panel
+ * @param d Context to initialize
+ * @param dev I2C device of the panel
+ * @param buf Frame buffer of SSD1306_W * SSD1306_H / 8 bytes
+ * @note Select it and call ssd1306_init() to bring the panel up; the
+ *       default display gets its device from ssd1306_init()
+ */
+void ssd1306_disp_init(ssd1306_disp_t *d, i2c_device_t *dev, uint8_t *buf);
+
+/**
+ * @brief Select the display that drawing, scrolling and refresh act on
+ * @param d Display context (ssd1306_disp0 is selected at start-up)
+ */
+void ssd1306_select(ssd1306_disp_t *d);
+
+/**
+ * @brief Get the selected display
+ * @return Display context drawn to
+ */
+ssd1306_disp_t *ssd1306_selected(void);
+
+#if SSD1306_DIRTY_TRACKING
+/**
+ * @brief Send the modified regions of several displays packet by packet,
+ *        taking turns so that none of them starves
+ * @param disp Display contexts
+ * @param n Number of displays
+ * @param packets Maximum number of data packets (of up to SSD1306_BURST bytes) to send
+ * @return 0 on success, non-zero if a packet failed (it stays pending)
+ * @note Call repeatedly from the main loop; ssd1306_refresh_pending() on each
+ *       selected display tells whether work is left
+ */
+uint8_t ssd1306_sched_run(ssd1306_disp_t *const *disp, uint32_t n, uint32_t packets);
+#endif
+#endif
+
+#if SSD1306_USE_DMA
+/**
+ * @brief Completion callback for asynchronous refresh, runs in interrupt context
+ * @param err 0 on success, non-zero on error
+ */
+typedef void (*ssd1306_refresh_cb_t)(uint8_t err);
+
+/**
+ * @brief Start a non-blocking refresh of the whole frame buffer via DMA
+ * @param dev I2C device structure pointer
+ * @param cb Completion callback, may be NULL
+ * @return 0 on success, non-zero on error (transfer not started)
+ * @note Neither ssd1306_buffer nor the I2C bus may be touched until the
+ *       transfer completes; fails while the start line makes the buffer
+ *       wrap around the end of controller RAM
+ */
+uint8_t ssd1306_refresh_start(i2c_device_t *dev, ssd1306_refresh_cb_t cb);
+
+/**
+ * @brief Check whether an asynchronous refresh is still in progress
+ * @return non-zero while busy
+ */
+uint8_t ssd1306_refresh_busy(void);
+
+/**
+ * @brief Block until the asynchronous refresh has completed
+ * @return 0 on success, non-zero if the transfer failed
+ */
+uint8_t ssd1306_refresh_wait(void);
+#endif
+
+#if SSD1306_USE_IRQ
+/**
+ * @brief Queue a command transaction, sent from the I2C interrupt
+ * @param dev I2C device structure pointer
+ * @param cmds Command bytes, referenced not copied
+ * @param sz Number of bytes, 1 to 65535
+ * @return 0 on success, non-zero if the queue has no room or a DMA
+ *         refresh is running
+ * @note cmds must stay valid and unchanged until ssd1306_queue_busy()
+ *       returns 0; a transaction the panel does not acknowledge is
+ *       dropped together with the rest of the call that queued it
+ */
+uint8_t ssd1306_queue_cmds(i2c_device_t *dev, const uint8_t *cmds, uint32_t sz);
+
+/**
+ * @brief Queue a data transaction, sent from the I2C interrupt
+ * @param dev I2C device structure pointer
+ * @param data Data bytes, referenced not copied
+ * @param sz Number of bytes, 1 to 65535
+ * @return 0 on success, non-zero if the queue has no room
+ * @note Sent as one transaction, SSD1306_BURST does not apply
+ */
+uint8_t ssd1306_queue_data(i2c_device_t *dev, const uint8_t *data, uint32_t sz);
+
+#if !SSD1306_ROTATE_90
+/**
+ * @brief Queue full-width buffer pages for where they belong in controller RAM
+ * @param dev I2C device structure pointer
+ * @param data SSD1306_W bytes per page, referenced not copied
+ * @param page First buffer page (0 = top display row)
+ * @param pages Number of pages
+ * @return 0 on success, non-zero if the queue has no room
+ * @note Takes two descriptors, four where the pages wrap around the end
+ *       of controller RAM
+ */
+uint8_t ssd1306_queue_pages(i2c_device_t *dev, const uint8_t *data, uint32_t page, uint32_t pages);
+
+#if SSD1306_FRAMEBUFFER
+/**
+ * @brief Queue a refresh of the whole frame buffer
+ * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero if the queue has no room
+ * @note ssd1306_buffer must not be drawn into until the queue is idle;
+ *       dirty pages count as sent and page hashes are forgotten
+ */
+uint8_t ssd1306_queue_refresh(i2c_device_t *dev);
+#endif
+#endif
+
+/**
+ * @brief Number of free descriptors in the transmit queue
+ */
+uint32_t ssd1306_queue_free(void);
+
+/**
+ * @brief Check whether queued transactions are still being sent
+ * @return non-zero while busy
+ */
+uint8_t ssd1306_queue_busy(void);
+
+/**
+ * @brief Block until the queue is empty
+ * @return non-zero if a transaction failed since the last call
+ * @note Blocking driver calls wait for the queue to drain by themselves
+ */
+uint8_t ssd1306_queue_wait(void);
+#endif
+
+#if SSD1306_STRIP_PAGES
+/**
+ * @brief Draw callback for strip rendering
+ * @param arg User argument passed to ssd1306_render_strips()
+ */
+typedef void (*ssd1306_draw_cb_t)(void *arg);
+
+/**
+ * @brief Render and send the display one strip at a time
+ * @param dev I2C device structure pointer
+ * @param draw Callback drawing the whole frame in panel coordinates, may be NULL
+ * @param arg User argument for the callback
+ * @return 0 on success, non-zero on error
+ * @note The callback runs once per SSD1306_STRIP_PAGES pages with drawing
+ *       clipped to the strip, which starts cleared; it must draw the same
+ *       frame every time
+ */
+uint8_t ssd1306_render_strips(i2c_device_t *dev, ssd1306_draw_cb_t draw, void *arg);
+#endif
+
+/* ============================================================================
+ * SCROLLING FUNCTIONS
+ * ============================================================================ */
+
+/**
+ * @brief Set the controller RAM row shown on the top display line
+ * @param dev I2C device structure pointer
+ * @param line RAM row, 0 .. 8*SSD1306_RAM_PAGES-1
+ * @return 0 on success, non-zero on error
+ * @note Buffer page p is sent to RAM page (p + line/8) so the buffer keeps
+ *       display coordinates; line%8 shifts the picture up by that many rows,
+ *       e.g. to smooth scroll between page steps. When line/8 changes the
+ *       whole buffer is marked for sending again
+ */
+uint8_t ssd1306_set_start_line(i2c_device_t *dev, uint32_t line);
+
+/**
+ * @brief Get the current start line
+ * @return RAM row shown on the top display line
+ */
+uint32_t ssd1306_get_start_line(void);
+
+#if SSD1306_FRAMEBUFFER && !SSD1306_ROTATE_90
+/**
+ * @brief Scroll the whole display up by whole pages without resending it
+ * @param dev I2C device structure pointer
+ * @param pages Pages to scroll up (negative scrolls down)
+ * @return 0 on success, non-zero on error
+ * @note The buffer is moved along and the uncovered pages are cleared and
+ *       marked modified; draw into them and refresh as usual
+ */
+uint8_t ssd1306_scroll_pages(i2c_device_t *dev, int32_t pages);
+#endif
+
+#ifndef SH1107
+/**
+ * @brief Start continuous hardware horizontal scrolling of a page range
+ * @param dev I2C device structure pointer
+ * @param left 0 scrolls right, 1 scrolls left
+ * @param p0 First buffer page
+ * @param p1 Last buffer page
+ * @param interval Frames per step code: 0=5 1=64 2=128 3=256 4=3 5=4 6=25 7=2
+ * @return 0 on success, non-zero on error (or if the range wraps in RAM)
+ * @note The buffer must not be sent while scrolling is active
+ */
+uint8_t ssd1306_hscroll(i2c_device_t *dev, uint8_t left, uint32_t p0, uint32_t p1, uint8_t interval);
+
+/**
+ * @brief Start continuous diagonal (vertical and horizontal) scrolling
+ * @param dev I2C device structure pointer
+ * @param left 0 scrolls right, 1 scrolls left
+ * @param p0 First buffer page scrolled horizontally
+ * @param p1 Last buffer page scrolled horizontally
+ * @param interval Frames per step code, as for ssd1306_hscroll()
+ * @param dy Rows scrolled up per step, 0 .. 63
+ * @return 0 on success, non-zero on error (or if the range wraps in RAM)
+ */
+uint8_t ssd1306_vhscroll(i2c_device_t *dev, uint8_t left, uint32_t p0, uint32_t p1, uint8_t interval, uint8_t dy);
+
+/**
+ * @brief Set the rows affected by vertical scrolling
+ * @param dev I2C device structure pointer
+ * @param top Fixed rows at the top
+ * @param rows Scrolled rows below them
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_vscroll_area(i2c_device_t *dev, uint8_t top, uint8_t rows);
+
+/**
+ * @brief Stop hardware scrolling
+ * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero on error
+ * @note The controller moved the RAM contents, so the next refresh
+ *       resends the whole buffer
  */
-void ssd1306_refresh(i2c_device_t *dev);
+uint8_t ssd1306_scroll_stop(i2c_device_t *dev);
+#endif
 
 /* ============================================================================
  * PIXEL MANIPULATION FUNCTIONS
@@ -217,7 +842,7 @@ void ssd1306_drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color);
  * @param w Width in pixels
  * @param color Line color (0 or 1)
  */
-void ssd1306_drawFastHLine(uint32_t x, uint32_t y, uint32_t w, uint32_t color);
+void ssd1306_drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color);
 
 /**
  * @brief Draw line between two points
@@ -226,6 +851,8 @@ void ssd1306_drawFastHLine(uint32_t x, uint32_t y, uint32_t w, uint32_t color);
  * @param x1 Ending X coordinate
  * @param y1 Ending Y coordinate
  * @param color Line color (0 or 1)
+ * @note Clipped once against the panel, so off-screen parts cost nothing;
+ *       horizontal and vertical lines use the fast line functions
  */
 void ssd1306_drawLine(int x0, int y0, int x1, int y1, uint32_t color);
 
@@ -244,6 +871,7 @@ void ssd1306_drawCircle(int x, int y, int radius, int color);
  * @param y Center Y coordinate
  * @param radius Circle radius
  * @param color Fill color (0 or 1)
+ * @note Every row is filled once, rows of equal width as one rectangle
  */
 void ssd1306_fillCircle(int x, int y, int radius, int color);
 
@@ -267,6 +895,29 @@ void ssd1306_drawRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t col
  */
 void ssd1306_fillRect(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t color);
 
+/**
+ * @brief Draw rounded rectangle outline
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width in pixels
+ * @param h Height in pixels
+ * @param r Corner radius, limited to half the shorter side
+ * @param color Line color (0 or 1)
+ */
+void ssd1306_drawRoundRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color);
+
+/**
+ * @brief Draw filled rounded rectangle
+ * @param x Starting X coordinate
+ * @param y Starting Y coordinate
+ * @param w Width in pixels
+ * @param h Height in pixels
+ * @param r Corner radius, limited to half the shorter side
+ * @param color Fill color (0 or 1)
+ * @note Same row merging as ssd1306_fillCircle(); w = h = 2*r+1 is a circle
+ */
+void ssd1306_fillRoundRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color);
+
 /**
  * @brief XOR rectangle (invert rectangular area)
  * @param x Starting X coordinate
@@ -274,23 +925,60 @@ void ssd1306_fillRect(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t co
  * @param w Width in pixels
  * @param h Height in pixels
  */
-void ssd1306_xorrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+void ssd1306_xorrect(int32_t x, int32_t y, int32_t w, int32_t h);
 
 /* ============================================================================
  * IMAGE RENDERING FUNCTIONS
  * ============================================================================ */
 
 /**
- * @brief Draw bitmap image
+ * @brief Draw bitmap image (horizontally packed, 8 pixels per byte)
  * @param x Starting X coordinate
  * @param y Starting Y coordinate
  * @param input Bitmap data pointer
  * @param width Image width in pixels
  * @param height Image height in pixels
- * @param color_mode Color mode (0 or 1)
+ * @param color_mode Blend mode (image_mode_t)
  */
 void ssd1306_drawImage(uint32_t x, uint32_t y, const unsigned char* input, uint32_t width, uint32_t height, uint32_t color_mode);
 
+/**
+ * @brief Draw page-format image (same layout as ssd1306_buffer)
+ * @param x Starting X coordinate (clipped, may be negative)
+ * @param y Starting Y coordinate (clipped, may be negative)
+ * @param input Image data, (height+7)/8 pages of width bytes, bit 0 = top row
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param color_mode Blend mode (image_mode_t)
+ * @note Convert bitmaps to this format with tools/img2page.py
+ */
+void ssd1306_drawPageImage(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode);
+
+/**
+ * @brief Draw RLE compressed page-format image
+ * @param x Starting X coordinate (clipped, may be negative)
+ * @param y Starting Y coordinate (clipped, may be negative)
+ * @param input Compressed data from tools/img2page.py --rle
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param color_mode Blend mode (image_mode_t)
+ * @note Decodes SSD1306_PSZ bytes at a time on the stack, no other RAM
+ */
+void ssd1306_drawRleImage(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode);
+
+#if !SSD1306_ROTATE_90
+/**
+ * @brief Decode a full-screen RLE image straight to the panel
+ * @param dev I2C device structure pointer
+ * @param input Compressed SSD1306_W x SSD1306_H image from tools/img2page.py --rle
+ * @return 0 on success, non-zero on error
+ * @note The frame buffer is not touched and need not exist; a later
+ *       ssd1306_refresh() replaces the image, ssd1306_refresh_dirty()
+ *       only draws over its modified spans
+ */
+uint8_t ssd1306_streamRleImage(i2c_device_t *dev, const uint8_t *input);
+#endif
+
 /* ============================================================================
  * TEXT RENDERING FUNCTIONS
  * ============================================================================ */
@@ -333,6 +1021,327 @@ void ssd1306_drawchar_sz(uint8_t x, uint8_t y, uint8_t chr, uint8_t color, font_
  */
 void ssd1306_drawstr_sz(uint8_t x, uint8_t y, char *str, uint8_t color, font_size_t font_size);
 
+#if !SSD1306_ROTATE_90
+/**
+ * @brief Write a string of 8x8 characters straight to the panel
+ * @param dev I2C device structure pointer
+ * @param x Starting X coordinate
+ * @param page Page (text row, y/8)
+ * @param str String to draw, clipped at the right edge
+ * @param color Text color (0 or 1)
+ * @param keep Non-zero to also store the glyphs in the frame buffer
+ * @return 0 on success, non-zero on error
+ * @note Sends one window and 8 bytes per character, nothing is rendered
+ *       or refreshed; without keep the field is marked modified so the
+ *       next refresh overwrites it. With keep a failed write marks it too
+ */
+uint8_t ssd1306_drawstr_direct(i2c_device_t *dev, uint32_t x, uint32_t page, const char *str, uint8_t color, uint8_t keep);
+#endif
+
+/**
+ * @brief Draw single character from a font descriptor
+ * @param x X coordinate (clipped, may be negative)
+ * @param y Y coordinate (clipped, may be negative)
+ * @param chr Character to draw
+ * @param color Text color (0 or 1), the glyph cell background gets the other
+ * @param font Font descriptor
+ * @return Advance in pixels (glyph width and spacing), 0 if not in the font
+ */
+uint32_t ssd1306_drawchar_font(int32_t x, int32_t y, uint8_t chr, uint8_t color, const ssd1306_font_t *font);
+
+/**
+ * @brief Draw string from a font descriptor, without wrapping
+ * @param x Starting X coordinate (clipped, may be negative)
+ * @param y Y coordinate (clipped, may be negative)
+ * @param str String to draw
+ * @param color Text color (0 or 1)
+ * @param font Font descriptor
+ * @return Width drawn in pixels
+ */
+uint32_t ssd1306_drawstr_font(int32_t x, int32_t y, const char *str, uint8_t color, const ssd1306_font_t *font);
+
+/**
+ * @brief Measure a string in a font descriptor
+ * @param str String to measure
+ * @param font Font descriptor
+ * @return Width in pixels ssd1306_drawstr_font() would draw
+ */
+uint32_t ssd1306_strwidth_font(const char *str, const ssd1306_font_t *font);
+
+#if SSD1306_CONSOLE
+/* ============================================================================
+ * CONSOLE FUNCTIONS
+ * ============================================================================ */
+
+/**
+ * @brief Clear the panel and start the console at the top line
+ * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero on error
+ * @note The console writes controller RAM directly and scrolls with the start
+ *       line; the frame buffer is left alone and fully resent by the next refresh
+ */
+uint8_t ssd1306_console_init(i2c_device_t *dev);
+
+/**
+ * @brief Write one character to the console ('\n' new line, '\r' line start)
+ * @param dev I2C device structure pointer
+ * @param c Character
+ * @return 0 on success, non-zero on error
+ * @note Lines wrap at the right edge; a line is sent when it ends or on
+ *       ssd1306_console_flush()
+ */
+uint8_t ssd1306_console_putc(i2c_device_t *dev, char c);
+
+/**
+ * @brief Write a string to the console and send the unfinished line, if any
+ * @param dev I2C device structure pointer
+ * @param str Null-terminated string
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_console_puts(i2c_device_t *dev, const char *str);
+
+/**
+ * @brief Send the line being built, scrolling first if it is a new bottom line
+ * @param dev I2C device structure pointer
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_console_flush(i2c_device_t *dev);
+#endif
+
+/* ============================================================================
+ * DISPLAY LIST FUNCTIONS
+ * ============================================================================ */
+
+// Recorded operation codes
+typedef enum {
+    dl_pixel, dl_hline, dl_vline, dl_line, dl_rect, dl_fillrect, dl_xorrect,
+    dl_circle, dl_fillcircle, dl_str, dl_str_sz, dl_image, dl_pageimage,
+    dl_roundrect, dl_fillroundrect, dl_rleimage,
+} dl_opcode_t;
+
+// One recorded drawing operation (16 bytes on 32-bit targets)
+typedef struct {
+    uint8_t op;          // dl_opcode_t
+    uint8_t color;       // color or blend mode
+    uint8_t size;        // font size for dl_str_sz, corner radius
+    uint8_t rsvd;
+    int16_t x, y;        // position (centre for circles)
+    int16_t a, b;        // width/height, end point or radius
+    const void *data;    // string or image data
+} ssd1306_dl_op_t;
+
+// Display list over caller-provided operation storage
+typedef struct {
+    ssd1306_dl_op_t *ops;
+    uint16_t cap;        // number of entries in ops
+    uint16_t len;        // entries recorded this frame
+    uint8_t overflow;    // an operation did not fit
+    uint32_t hash;       // hash of the frame being recorded
+    uint32_t last_hash;  // hash of the last rendered frame
+} ssd1306_dl_t;
+
+/**
+ * @brief Initialize a display list
+ * @param dl Display list
+ * @param ops Operation storage
+ * @param cap Number of entries in ops
+ */
+void ssd1306_dl_init(ssd1306_dl_t *dl, ssd1306_dl_op_t *ops, uint32_t cap);
+
+/**
+ * @brief Start recording a new frame
+ * @param dl Display list
+ */
+void ssd1306_dl_begin(ssd1306_dl_t *dl);
+
+/**
+ * @brief Finish recording a frame
+ * @param dl Display list
+ * @return non-zero if the frame differs from the last rendered one
+ * @note Strings are hashed by content, images by address only
+ */
+uint8_t ssd1306_dl_end(ssd1306_dl_t *dl);
+
+/*
+ * Recording counterparts of the drawing primitives, same arguments
+ */
+void ssd1306_dl_drawPixel(ssd1306_dl_t *dl, int32_t x, int32_t y, int color);
+void ssd1306_dl_drawFastHLine(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, uint32_t color);
+void ssd1306_dl_drawFastVLine(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t h, uint32_t color);
+void ssd1306_dl_drawLine(ssd1306_dl_t *dl, int x0, int y0, int x1, int y1, uint32_t color);
+void ssd1306_dl_drawRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color);
+void ssd1306_dl_fillRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color);
+void ssd1306_dl_xorrect(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, int32_t h);
+void ssd1306_dl_drawCircle(ssd1306_dl_t *dl, int x, int y, int radius, int color);
+void ssd1306_dl_fillCircle(ssd1306_dl_t *dl, int x, int y, int radius, int color);
+void ssd1306_dl_drawRoundRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color);
+void ssd1306_dl_fillRoundRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color);
+void ssd1306_dl_drawstr(ssd1306_dl_t *dl, uint8_t x, uint8_t y, char *str, uint8_t color);
+void ssd1306_dl_drawstr_sz(ssd1306_dl_t *dl, uint8_t x, uint8_t y, char *str, uint8_t color, font_size_t font_size);
+void ssd1306_dl_drawImage(ssd1306_dl_t *dl, uint32_t x, uint32_t y, const unsigned char* input, uint32_t width, uint32_t height, uint32_t color_mode);
+void ssd1306_dl_drawPageImage(ssd1306_dl_t *dl, int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode);
+void ssd1306_dl_drawRleImage(ssd1306_dl_t *dl, int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode);
+
+/**
+ * @brief Replay the recorded operations that intersect a rectangle
+ * @param dl Display list
+ * @param x Rectangle X coordinate
+ * @param y Rectangle Y coordinate
+ * @param w Rectangle width
+ * @param h Rectangle height
+ * @note Operations are not clipped to the rectangle, clear it first
+ *       (ssd1306_setbuf_rect) if it should only show the replayed content
+ */
+void ssd1306_dl_replay(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, int32_t h);
+
+#if SSD1306_STRIP_PAGES
+/**
+ * @brief ssd1306_render_strips() callback replaying the operations of the current strip
+ * @param arg Display list (ssd1306_dl_t *)
+ */
+void ssd1306_dl_draw_strip(void *arg);
+#endif
+
+/**
+ * @brief Render the recorded frame and send it, unless it is unchanged
+ * @param dl Display list (recording finished with ssd1306_dl_end)
+ * @param dev I2C device structure pointer
+ * @return 0 if nothing changed or on success, non-zero on error
+ */
+uint8_t ssd1306_dl_render(ssd1306_dl_t *dl, i2c_device_t *dev);
+
+/* ============================================================================
+ * SPRITE FUNCTIONS
+ * ============================================================================ */
+
+#if SSD1306_FRAMEBUFFER
+// Background bytes a w x h sprite can cover, for its save slot
+#define SSD1306_SPRITE_SAVE(w, h) ((w) * (((h) + 7) / 8 + 1))
+
+// Buffer columns x .. x+n-1 of pages p .. p+np-1, n = 0 when empty
+typedef struct {
+    uint8_t x, n;
+    uint8_t p, np;
+} ssd1306_sprite_box_t;
+
+// A page-format image moved over the frame buffer; set x, y and image
+// between frames, the rest is kept by the sprite functions
+typedef struct {
+    const uint8_t *image;         // page-format image, NULL hides the sprite
+    uint8_t *save;                // SSD1306_SPRITE_SAVE(w, h) bytes, NULL = XOR mode
+    int16_t x, y;                 // top left corner
+    uint8_t w, h;                 // image size
+    uint8_t mode;                 // blend mode with a save slot, XOR without
+    const uint8_t *drawn;         // image on the buffer and its position
+    int16_t dx, dy;
+    ssd1306_sprite_box_t box;     // buffer area it covers now
+    ssd1306_sprite_box_t old;     // area erased but not sent yet
+} ssd1306_sprite_t;
+
+/**
+ * @brief Set up a sprite, hidden at 0,0 until it is drawn
+ * @param s Sprite
+ * @param image Page-format image (same layout as ssd1306_drawPageImage)
+ * @param w Image width
+ * @param h Image height
+ * @param mode Blend mode (imagemode_*) over the saved background
+ * @param save SSD1306_SPRITE_SAVE(w, h) bytes for the background under the
+ *        sprite, or NULL to draw and erase it with XOR and no extra RAM
+ */
+void ssd1306_sprite_init(ssd1306_sprite_t *s, const uint8_t *image, uint32_t w, uint32_t h, uint32_t mode, uint8_t *save);
+
+/**
+ * @brief Take sprites off the buffer, last one first
+ * @param s Sprite array
+ * @param n Number of sprites
+ * @note Restores the saved background, so draw background changes only while
+ *       the sprites are erased
+ */
+void ssd1306_sprites_erase(ssd1306_sprite_t *s, uint32_t n);
+
+/**
+ * @brief Save the background under each sprite and draw it, first one first
+ * @param s Sprite array
+ * @param n Number of sprites
+ */
+void ssd1306_sprites_draw(ssd1306_sprite_t *s, uint32_t n);
+
+/**
+ * @brief Send the areas sprites left and now cover
+ * @param dev I2C device structure pointer
+ * @param s Sprite array
+ * @param n Number of sprites
+ * @return 0 on success, non-zero on error (the areas are sent again next time)
+ * @note Old and new boxes are joined where one address window costs fewer
+ *       bus bytes than two; with SSD1306_ROTATE_90 the whole buffer is sent
+ */
+uint8_t ssd1306_sprites_refresh(i2c_device_t *dev, ssd1306_sprite_t *s, uint32_t n);
+
+/**
+ * @brief Move sprites to their new x, y and image: erase, draw and refresh
+ * @param dev I2C device structure pointer
+ * @param s Sprite array
+ * @param n Number of sprites
+ * @return 0 on success, non-zero on error
+ */
+uint8_t ssd1306_sprites_update(i2c_device_t *dev, ssd1306_sprite_t *s, uint32_t n);
+#endif
+
+/* ============================================================================
+ * CANVAS FUNCTIONS
+ * ============================================================================ */
+
+#if SSD1306_CANVAS
+// Bytes of a w x h canvas
+#define SSD1306_CANVAS_SIZE(w, h) ((w) * (((h) + 7) / 8))
+
+// Off-screen drawing surface laid out like ssd1306_buffer
+typedef struct {
+    uint8_t *buf;                 // SSD1306_CANVAS_SIZE(w, h) bytes
+    uint8_t w, h;                 // size in pixels
+} ssd1306_canvas_t;
+
+/**
+ * @brief Set up a canvas and clear it
+ * @param c Canvas
+ * @param buf SSD1306_CANVAS_SIZE(w, h) bytes
+ * @param w Width in pixels, 1 to 255
+ * @param h Height in pixels, 1 to 255
+ */
+void ssd1306_canvas_init(ssd1306_canvas_t *c, uint8_t *buf, uint32_t w, uint32_t h);
+
+/**
+ * @brief Send all drawing to a canvas until ssd1306_canvas_end()
+ * @param c Canvas
+ * @note Coordinates are canvas-relative and clip at its edges,
+ *       ssd1306_setbuf() clears the canvas. Drawing below h in the last
+ *       page is allowed but never blitted. The sprite functions and
+ *       ssd1306_dl_render() still draw on the frame buffer (they switch
+ *       to it for the call), ssd1306_dl_replay() draws on the canvas. With
+ *       SSD1306_MULTI, ssd1306_select() inside a canvas takes effect at
+ *       ssd1306_canvas_end()
+ */
+void ssd1306_canvas_begin(ssd1306_canvas_t *c);
+
+/**
+ * @brief Go back to the target drawn to before ssd1306_canvas_begin()
+ */
+void ssd1306_canvas_end(void);
+
+/**
+ * @brief Blend a canvas into the current target
+ * @param c Canvas, must not be the current target
+ * @param x Left edge in the target (clipped, may be negative)
+ * @param y Top edge in the target (clipped, may be negative)
+ * @param color_mode Blend mode (image_mode_t)
+ * @note Same path as ssd1306_drawPageImage(): byte copies when y is
+ *       page-aligned, shifted merges otherwise. Marks the area dirty when
+ *       the target is the frame buffer. Blit into another canvas to
+ *       compose them
+ */
+void ssd1306_blit(const ssd1306_canvas_t *c, int32_t x, int32_t y, uint32_t color_mode);
+#endif
+
 /* ============================================================================
  * UTILITY FUNCTIONS
  * ============================================================================ */
@@ -49,6 +49,24 @@ const unsigned char bomb_i_stripped[] = {
 };
 const unsigned int bomb_i_stripped_len = 128;
 
+/*
+ * Same bomb in page format for ssd1306_drawPageImage()
+ * (generated with tools/img2page.py --hbitmap 32x32)
+ */
+const uint8_t bomb_p[] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x40, 0x20, 0xa0, 0x40, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0xe0, 0xf0, 0xf0, 0xf8, 0xf8,
+  0xfc, 0xff, 0xfc, 0xfe, 0xfd, 0xf8, 0xf8, 0xf0, 0xf0, 0xe0, 0x80, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x3e, 0xff, 0xff, 0xc1, 0xc1, 0xff, 0xff, 0xff, 0xc1, 0xc1, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x30, 0x2b,
+  0x27, 0x27, 0x2f, 0x2f, 0x3f, 0x3f, 0x2f, 0x27, 0x27, 0x27, 0x27, 0x27,
+  0x27, 0x2b, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
 /* ============================================================================
  * POWER MANAGEMENT FUNCTIONS
  * ============================================================================ */
@@ -86,10 +104,11 @@ static void init_lcd_power(void)
  */
 static void test_binary_pattern(void)
 {
-	printf("buffer fill with binary\n\r");
+#if SSD1306_FRAMEBUFFER
 	for (int i = 0; i < sizeof(ssd1306_buffer); i++) {
 		ssd1306_buffer[i] = i;
 	}
+#endif
 }
 
 /**
@@ -97,10 +116,9 @@ static void test_binary_pattern(void)
  */
 static void test_pixel_plots(void)
 {
-	printf("pixel plots\n\r");
 	for (int i = 0; i < SSD1306_W; i++) {
-		ssd1306_drawPixel(i, i / (SSD1306_W / SSD1306_H), 1);
-		ssd1306_drawPixel(i, SSD1306_H - 1 - (i / (SSD1306_W / SSD1306_H)), 1);
+		ssd1306_drawPixel(i, i * SSD1306_H / SSD1306_W, 1);
+		ssd1306_drawPixel(i, SSD1306_H - 1 - (i * SSD1306_H / SSD1306_W), 1);
 	}
 }
 
@@ -109,7 +127,6 @@ static void test_pixel_plots(void)
  */
 static void test_line_plots(void)
 {
-	printf("Line plots\n\r");
 	uint8_t y = 0;
 	for (uint8_t x = 0; x < SSD1306_W; x += 16) {
 		ssd1306_drawLine(x, 0, SSD1306_W, y, 1);
@@ -123,7 +140,6 @@ static void test_line_plots(void)
  */
 static void test_circles(void)
 {
-	printf("Circles empty and filled\n\r");
 	for (uint8_t x = 0; x < SSD1306_W; x += 16) {
 		if (x < 64) {
 			ssd1306_drawCircle(x, SSD1306_H / 2, 15, 1);
@@ -138,7 +154,6 @@ static void test_circles(void)
  */
 static void test_image_display(void)
 {
-	printf("Image\n\r");
 	ssd1306_drawImage(0, 0, bomb_i_stripped, 32, 32, 0);
 }
 
@@ -147,7 +162,6 @@ static void test_image_display(void)
  */
 static void test_unscaled_text(void)
 {
-	printf("Unscaled Text\n\r");
 	ssd1306_drawstr(0, 0, "This is a test", 1);
 	ssd1306_drawstr(0, 8, "of the emergency", 1);
 	ssd1306_drawstr(0, 16, "broadcasting", 1);
@@ -170,7 +184,6 @@ static void test_unscaled_text(void)
  */
 static void test_scaled_text_small(void)
 {
-	printf("Scaled Text 1, 2\n\r");
 	ssd1306_drawstr_sz(0, 0, "sz 8x8", 1, fontsize_8x8);
 	ssd1306_drawstr_sz(0, 16, "16x16", 1, fontsize_16x16);
 }
@@ -180,7 +193,6 @@ static void test_scaled_text_small(void)
  */
 static void test_scaled_text_medium(void)
 {
-	printf("Scaled Text 4\n\r");
 	ssd1306_drawstr_sz(0, 0, "32x32", 1, fontsize_32x32);
 }
 
@@ -189,10 +201,189 @@ static void test_scaled_text_medium(void)
  */
 static void test_scaled_text_large(void)
 {
-	printf("Scaled Text 8\n\r");
 	ssd1306_drawstr_sz(0, 0, "64", 1, fontsize_64x64);
 }
 
+// Test mode names, printed when a mode is shown
+static const char *const test_mode_names[] = {
+	"buffer fill with binary",
+	"pixel plots",
+	"Line plots",
+	"Circles empty and filled",
+	"Image",
+	"Unscaled Text",
+	"Scaled Text 1, 2",
+	"Scaled Text 4",
+	"Scaled Text 8",
+};
+
+/**
+ * @brief Draw the current test mode
+ * @param arg Pointer to the uint8_t mode number
+ *
+ * Also used as the ssd1306_render_strips() callback when there is no frame buffer.
+ */
+static void draw_test_mode(void *arg)
+{
+	switch (*(uint8_t *)arg) {
+		case 0: test_binary_pattern();     break;
+		case 1: test_pixel_plots();        break;
+		case 2: test_line_plots();         break;
+		case 3: test_circles();            break;
+		case 4: test_image_display();      break;
+		case 5: test_unscaled_text();      break;
+		case 6: test_scaled_text_small();  break;
+		case 7: test_scaled_text_medium(); break;
+		case 8: test_scaled_text_large();  break;
+		default: break;
+	}
+}
+
+#if defined(LCD_BENCHMARK) && LCD_BENCHMARK
+/* ============================================================================
+ * BENCHMARK MODE
+ * ============================================================================ */
+
+// Each case runs this many times, the average is reported
+#ifndef BENCH_RUNS
+#define BENCH_RUNS 16
+#endif
+
+// SysTick runs at HCLK or HCLK/8 depending on FUNCONF_SYSTICK_USE_HCLK
+#define BENCH_CYCLES_PER_TICK (FUNCONF_SYSTEM_CORE_CLOCK / (DELAY_US_TIME * 1000000))
+
+typedef struct {
+	const char *name;
+	void (*setup)(void);   // untimed preparation before every run, may be NULL
+	void (*run)(void);     // timed operation
+	uint32_t pixels;       // pixels touched per run
+	uint32_t bus_bytes;    // expected bytes on the I2C bus per run (incl. address bytes)
+} bench_case_t;
+
+// bytes for a 6 byte window command and a data payload in SSD1306_BURST transactions
+#define BENCH_WINDOW_BYTES (1 + 1 + 6)
+#define BENCH_DATA_BYTES(n) ((n) + 2 * (((n) + SSD1306_BURST - 1) / SSD1306_BURST))
+
+static void bench_pixel(void)      { ssd1306_drawPixel(17, 11, 1); }
+static void bench_hline(void)      { ssd1306_drawFastHLine(0, 11, SSD1306_W, 1); }
+static void bench_vline(void)      { ssd1306_drawFastVLine(17, 0, SSD1306_H, 1); }
+static void bench_fillrect(void)   { ssd1306_fillRect(5, 3, 32, 16, 1); }
+static void bench_xorrect(void)    { ssd1306_xorrect(0, 0, SSD1306_W / 2, SSD1306_H); }
+static void bench_line(void)       { ssd1306_drawLine(0, 0, SSD1306_W - 1, SSD1306_H - 1, 1); }
+static void bench_circle(void)     { ssd1306_drawCircle(SSD1306_W / 2, SSD1306_H / 2, 15, 1); }
+static void bench_fillcircle(void) { ssd1306_fillCircle(SSD1306_W / 2, SSD1306_H / 2, 15, 1); }
+static void bench_char(void)       { ssd1306_drawchar(16, 8, 'A', 1); }
+static void bench_char_unal(void)  { ssd1306_drawchar(16, 11, 'A', 1); }
+static void bench_str(void)        { ssd1306_drawstr(0, 8, "0123456789ABCDEF", 1); }
+static void bench_char16(void)     { ssd1306_drawchar_sz(0, 0, '8', 1, fontsize_16x16); }
+static void bench_char32(void)     { ssd1306_drawchar_sz(0, 0, '8', 1, fontsize_32x32); }
+static void bench_char64(void)     { ssd1306_drawchar_sz(0, 0, '8', 1, fontsize_64x64); }
+static void bench_image(void)      { ssd1306_drawImage(0, 0, bomb_i_stripped, 32, 32, imagemode_copy); }
+static void bench_pageimg(void)    { ssd1306_drawPageImage(8, 0, bomb_p, 32, 32, imagemode_copy); }
+static void bench_pageimg_un(void) { ssd1306_drawPageImage(8, 3, bomb_p, 32, 29, imagemode_or); }
+static void bench_setbuf(void)     { ssd1306_setbuf(0); }
+#if SSD1306_FRAMEBUFFER
+static void bench_refresh(void)    { ssd1306_refresh(&ssd1306_dev); }
+#endif
+#if SSD1306_STRIP_PAGES
+static uint8_t bench_strip_mode = 5;
+static void bench_strips(void)     { ssd1306_render_strips(&ssd1306_dev, draw_test_mode, &bench_strip_mode); }
+#endif
+#if SSD1306_DIRTY_TRACKING
+static void bench_dirty_setup(void) { ssd1306_drawchar(64, 8, '7', 1); }
+static void bench_refresh_dirty(void) { ssd1306_refresh_dirty(&ssd1306_dev); }
+#endif
+#if SSD1306_USE_DMA
+static void bench_refresh_dma(void) { ssd1306_refresh_start(&ssd1306_dev, NULL); ssd1306_refresh_wait(); }
+#endif
+
+static const bench_case_t bench_cases[] = {
+	{ "drawPixel",    NULL, bench_pixel,      1, 0 },
+	{ "hline",        NULL, bench_hline,      SSD1306_W, 0 },
+	{ "vline",        NULL, bench_vline,      SSD1306_H, 0 },
+	{ "fillRect",     NULL, bench_fillrect,   32 * 16, 0 },
+	{ "xorrect",      NULL, bench_xorrect,    SSD1306_W / 2 * SSD1306_H, 0 },
+	{ "drawLine",     NULL, bench_line,       SSD1306_W, 0 },
+	{ "drawCircle",   NULL, bench_circle,     4 * 15, 0 },
+	{ "fillCircle",   NULL, bench_fillcircle, 707, 0 },
+	{ "char 8x8",     NULL, bench_char,       64, 0 },
+	{ "char unalgn",  NULL, bench_char_unal,  64, 0 },
+	{ "str 16ch",     NULL, bench_str,        16 * 64, 0 },
+	{ "char 16x16",   NULL, bench_char16,     16 * 16, 0 },
+	{ "char 32x32",   NULL, bench_char32,     32 * 32, 0 },
+	{ "char 64x64",   NULL, bench_char64,     64 * 64, 0 },
+	{ "drawImage",    NULL, bench_image,      32 * 32, 0 },
+	{ "pageImage",    NULL, bench_pageimg,    32 * 32, 0 },
+	{ "pageImg unal", NULL, bench_pageimg_un, 32 * 29, 0 },
+	{ "setbuf",       NULL, bench_setbuf,     SSD1306_W * SSD1306_H, 0 },
+#if SSD1306_FRAMEBUFFER
+	{ "refresh",      NULL, bench_refresh,    SSD1306_W * SSD1306_H,
+		BENCH_WINDOW_BYTES + BENCH_DATA_BYTES(sizeof(ssd1306_buffer)) },
+#endif
+#if SSD1306_STRIP_PAGES
+	{ "strips text",  NULL, bench_strips,     SSD1306_W * SSD1306_H,
+		((SSD1306_PAGES + SSD1306_STRIP_PAGES - 1) / SSD1306_STRIP_PAGES) *
+		(BENCH_WINDOW_BYTES + BENCH_DATA_BYTES(SSD1306_W * SSD1306_STRIP_PAGES)) },
+#endif
+#if SSD1306_DIRTY_TRACKING
+	{ "refresh dirty", bench_dirty_setup, bench_refresh_dirty, 64,
+		BENCH_WINDOW_BYTES + BENCH_DATA_BYTES(8) },
+#endif
+#if SSD1306_USE_DMA
+	{ "refresh dma",  NULL, bench_refresh_dma, SSD1306_W * SSD1306_H,
+		BENCH_WINDOW_BYTES + 2 + sizeof(ssd1306_buffer) },
+#endif
+};
+
+/**
+ * @brief Time every benchmark case with SysTick and print the results
+ */
+static void run_benchmark(void)
+{
+	printf("\n\r%lux%lu, %lu MHz, %lu runs\n\r", (unsigned long)SSD1306_W, (unsigned long)SSD1306_H,
+		(unsigned long)(FUNCONF_SYSTEM_CORE_CLOCK / 1000000), (unsigned long)BENCH_RUNS);
+#if SSD1306_STATS
+	// bus columns are measured by the driver instead of predicted
+	printf("case            cyc/op       px/s  bus B/op xfer/op  i2c cyc/op  err\n\r");
+#else
+	printf("case            cyc/op       px/s  bus B/op\n\r");
+#endif
+
+	for (uint32_t c = 0; c < sizeof(bench_cases) / sizeof(bench_cases[0]); c++) {
+		const bench_case_t *bc = &bench_cases[c];
+		uint32_t ticks = 0;
+#if SSD1306_STATS
+		ssd1306_stats_t before = ssd1306_stats;
+#endif
+
+		for (int i = 0; i < BENCH_RUNS; i++) {
+			if (bc->setup) {
+				bc->setup();
+			}
+			uint32_t start = SysTick->CNT;
+			bc->run();
+			ticks += SysTick->CNT - start;
+		}
+
+		uint32_t cycles = ticks * BENCH_CYCLES_PER_TICK / BENCH_RUNS;
+		uint32_t px_per_s = cycles ? (uint32_t)((uint64_t)bc->pixels * FUNCONF_SYSTEM_CORE_CLOCK / cycles) : 0;
+#if SSD1306_STATS
+		uint32_t xfers = (ssd1306_stats.cmd_xfers + ssd1306_stats.data_xfers) -
+			(before.cmd_xfers + before.data_xfers);
+		printf("%-13s %8lu %10lu %9lu %7lu %11lu %4lu\n\r", bc->name, (unsigned long)cycles,
+			(unsigned long)px_per_s,
+			(unsigned long)((ssd1306_stats.bytes - before.bytes) / BENCH_RUNS),
+			(unsigned long)(xfers / BENCH_RUNS),
+			(unsigned long)((ssd1306_stats.i2c_ticks - before.i2c_ticks) * BENCH_CYCLES_PER_TICK / BENCH_RUNS),
+			(unsigned long)(ssd1306_stats.errors - before.errors));
+#else
+		printf("%-13s %8lu %10lu %9lu\n\r", bc->name, (unsigned long)cycles,
+			(unsigned long)px_per_s, (unsigned long)bc->bus_bytes);
+#endif
+	}
+}
+#endif
+
 /* ============================================================================
  * MAIN EXAMPLE FUNCTION
  * ============================================================================ */
@@ -211,32 +402,38 @@ int main(void)
 	Delay_Ms(100);
 	
 	i2c_init(&ssd1306_dev);
+#if SSD1306_CLOCK_ADAPT
+	// Run the bus as fast as this module allows, up to 1MHz
+	ssd1306_clock_calibrate(&ssd1306_dev, I2C_CLK_1MHZ);
+#endif
 	ssd1306_init(&ssd1306_dev);
 
+#if defined(LCD_BENCHMARK) && LCD_BENCHMARK
+	// Benchmark instead of the demo, repeated every few seconds
+	while(1) {
+		run_benchmark();
+		Delay_Ms(5000);
+	}
+#endif
+
 	// Main demonstration loop
 	uint8_t mode = 0;
 	const uint8_t max_modes = (SSD1306_H > 32) ? 9 : 8;
 	
 	while(1) {
-		// Clear display buffer for next demonstration
-		ssd1306_setbuf(0);
+		printf("%s\n\r", test_mode_names[mode]);
 
-		// Execute current test mode
-		switch (mode) {
-			case 0: test_binary_pattern();     break;
-			case 1: test_pixel_plots();        break;
-			case 2: test_line_plots();         break;
-			case 3: test_circles();            break;
-			case 4: test_image_display();      break;
-			case 5: test_unscaled_text();      break;
-			case 6: test_scaled_text_small();  break;
-			case 7: test_scaled_text_medium(); break;
-			case 8: test_scaled_text_large();  break;
-			default: break;
-		}
-		
-		// Update display and advance to next mode
+#if SSD1306_FRAMEBUFFER
+		// Clear display buffer, draw and update display
+		ssd1306_setbuf(0);
+		draw_test_mode(&mode);
 		ssd1306_refresh(&ssd1306_dev);
+#else
+		// No frame buffer: draw and send one strip at a time
+		ssd1306_render_strips(&ssd1306_dev, draw_test_mode, &mode);
+#endif
+
+		// Advance to next mode
 		mode = (mode + 1) % max_modes;
 
 		// Wait before next demonstration
@@ -17,7 +17,14 @@
  * - XOR operations for highlighting and animation
  * ============================================================================ */
 
+#include <stddef.h>
 #include "myssd1306.h"
+#ifdef SSD1306_FONT_CM
+#include "font_8x8_cm.h"
+#endif
+#if SSD1306_USE_DMA || SSD1306_USE_IRQ || SSD1306_STATS_TIMING
+#include "ch32fun.h"
+#endif
 
 /* ============================================================================
  * DISPLAY INITIALIZATION ARRAYS
@@ -38,7 +45,7 @@ const uint8_t ssd1306_init_array[] =
 	SSD1306_SETCONTRAST, 0x6f,        // Set constrast
 	SSD1306_COLUMNADDR,               // Set memory addressing mode
 	SSD1306_DISPLAYALLON_RESUME,      // normal (as opposed to invert colors, always on or off.)
-	SSD1306_SETMULTIPLEX, (SSD1306_H-1), // Iterate over all 128 rows (Multiplex Ratio)
+	SSD1306_SETMULTIPLEX, (SSD1306_PANEL_H-1), // Iterate over all 128 rows (Multiplex Ratio)
 	SSD1306_SETDISPLAYOFFSET, 0x00,   // Set display offset // Where this appears on-screen  (Some displays will be different)
 	SSD1306_SETDISPLAYCLOCKDIV, 0xf0, // Set precharge properties.  THIS IS A LIE  This has todo with timing.  <<< This makes it go brrrrrrrrr
 	SSD1306_SETPRECHARGE, 0x1d,       // Set pre-charge period  (This controls brightness)
@@ -49,7 +56,7 @@ const uint8_t ssd1306_init_array[] =
 	SSD1306_SETPRECHARGE, 0x06,       // ???? No idea what this does, but this looks best.
 	SSD1306_SETCONTRAST, 0xfe,        // Set constrast
 	SSD1306_SETVCOMDETECT, 0xfe,      // Set vcomh
-	SSD1306_SETMULTIPLEX, (SSD1306_H-1), // 128-wide.
+	SSD1306_SETMULTIPLEX, (SSD1306_PANEL_H-1), // 128-wide.
 	SSD1306_DISPLAYON, // Display on.
 #else
     SSD1306_DISPLAYOFF,                    // 0xAE
@@ -99,499 +106,3260 @@ const uint8_t ssd1306_init_array[] =
 };
 #endif
 
+#if SSD1306_FRAMEBUFFER
 // the display buffer
 uint8_t ssd1306_buffer[SSD1306_W * SSD1306_H / 8];
+#endif
+#define SSD1306_FB_SIZE (SSD1306_W * SSD1306_PAGES)
+
+#if SSD1306_MULTI
+// the default display owns ssd1306_buffer, the selected one is drawn to
+ssd1306_disp_t ssd1306_disp0 = { .buf = ssd1306_buffer };
+static ssd1306_disp_t *ssd1306_disp = &ssd1306_disp0;
+
+#define DISP_BUF        (ssd1306_disp->buf)
+#define DISP_DIRTY_X0   (ssd1306_disp->dirty_x0)
+#define DISP_DIRTY_X1   (ssd1306_disp->dirty_x1)
+#define DISP_HASH       (ssd1306_disp->page_hash)
+#define DISP_HASH_VALID (ssd1306_disp->hash_valid)
+#define DISP_START_LINE (ssd1306_disp->start_line)
+#define DISP_PKT_PAGE   (ssd1306_disp->pkt_page)
+#else
+#if SSD1306_DIRTY_TRACKING
+// modified column range per page, x0 > x1 means the page is clean
+static uint8_t ssd1306_dirty_x0[SSD1306_PAGES];
+static uint8_t ssd1306_dirty_x1[SSD1306_PAGES];
+// next page to look at for an incremental refresh packet
+static uint8_t ssd1306_pkt_page;
+#endif
+
+#if SSD1306_PAGE_HASH
+// hash of every page as last sent, only meaningful where the bit in
+// ssd1306_hash_valid is set
+static uint32_t ssd1306_page_hash[SSD1306_PAGES];
+static uint32_t ssd1306_hash_valid;
+#endif
+
+// controller RAM row shown on the top display line
+static uint8_t ssd1306_start_line;
+
+#define DISP_BUF        ssd1306_buffer
+#define DISP_DIRTY_X0   ssd1306_dirty_x0
+#define DISP_DIRTY_X1   ssd1306_dirty_x1
+#define DISP_HASH       ssd1306_page_hash
+#define DISP_HASH_VALID ssd1306_hash_valid
+#define DISP_START_LINE ssd1306_start_line
+#define DISP_PKT_PAGE   ssd1306_pkt_page
+#endif
+
+#if SSD1306_STRIP_PAGES
+// strip buffer for ssd1306_render_strips()
+static uint8_t ssd1306_strip[SSD1306_W * SSD1306_STRIP_PAGES];
+#endif
+
+#if SSD1306_STRIP_PAGES || SSD1306_CANVAS
+// drawing target: the frame buffer, the strip being rendered which
+// covers panel rows y0 .. y0 + 8*pages - 1, or a canvas
+typedef struct {
+	uint8_t *buf;
+	int32_t y0;
+	uint32_t pages;
+	uint8_t dirty;      // update dirty tracking (frame buffer only)
+	int32_t w;          // columns, SSD1306_W unless drawing into a canvas
+} ssd1306_target_t;
+
+static ssd1306_target_t ssd1306_target =
+#if SSD1306_FRAMEBUFFER
+	{ ssd1306_buffer, 0, SSD1306_PAGES, 1, SSD1306_W };
+#else
+	{ ssd1306_strip, 0, SSD1306_STRIP_PAGES, 0, SSD1306_W };
+#endif
+
+#define TARGET_BUF   (ssd1306_target.buf)
+#define TARGET_Y0    (ssd1306_target.y0)
+#define TARGET_PAGES (ssd1306_target.pages)
+#define TARGET_DIRTY (ssd1306_target.dirty)
+#else
+// drawing always goes to the frame buffer
+#define TARGET_BUF   DISP_BUF
+#define TARGET_Y0    0
+#define TARGET_PAGES SSD1306_PAGES
+#define TARGET_DIRTY 1
+#endif
+#if SSD1306_CANVAS
+// target to return to from a canvas, valid while ssd1306_canvas_on is set
+static ssd1306_target_t ssd1306_canvas_prev;
+static uint8_t ssd1306_canvas_on;
+
+#define TARGET_W     (ssd1306_target.w)
+
+// sprite and display list calls draw on the frame buffer inside a canvas too
+#define SSD1306_FB_ENTER() ssd1306_target_t ssd1306_fb_saved = ssd1306_target; \
+	if(ssd1306_canvas_on) ssd1306_target = ssd1306_canvas_prev
+#define SSD1306_FB_LEAVE() (ssd1306_target = ssd1306_fb_saved)
+#else
+#define TARGET_W     SSD1306_W
+#define SSD1306_FB_ENTER() do { } while(0)
+#define SSD1306_FB_LEAVE() ((void)0)
+#endif
+#define TARGET_H     (TARGET_PAGES * 8)
 
+#if SSD1306_DIRTY_TRACKING
 /*
- * reset is not used for SSD1306 I2C interface
+ * widen the dirty column range of a page
  */
-void ssd1306_rst(void)
+static inline void ssd1306_dirty_span(uint32_t page, uint32_t x0, uint32_t x1)
 {
+	if(x0 < DISP_DIRTY_X0[page])
+		DISP_DIRTY_X0[page] = x0;
+	if(x1 > DISP_DIRTY_X1[page])
+		DISP_DIRTY_X1[page] = x1;
 }
 
 /*
- * send OLED command byte
+ * mark every page as unmodified
  */
-uint8_t ssd1306_cmd(i2c_device_t *dev, uint8_t cmd)
+static void ssd1306_dirty_clear(void)
 {
-	return (uint8_t)i2c_write_raw(dev, (uint8_t[]){0x00, cmd}, 2);
+	memset(DISP_DIRTY_X0, 0xFF, sizeof(DISP_DIRTY_X0));
+	memset(DISP_DIRTY_X1, 0x00, sizeof(DISP_DIRTY_X1));
 }
 
 /*
- * send OLED data packet (up to 32 bytes)
+ * mark every page as fully modified
  */
-uint8_t ssd1306_data(i2c_device_t *dev, uint8_t *data, int sz)
+static void ssd1306_dirty_all(void)
 {
-	uint8_t pkt[SSD1306_PSZ + 1]; // +1 for command byte
-
-	/* build data packet */
-	if(sz > SSD1306_PSZ) sz = SSD1306_PSZ; // limit to max packet size
-	pkt[0] = 0x40; // 0 = next byte is data
-	memcpy(&pkt[1], data, sz);
-
-	return (uint8_t)i2c_write_raw(dev, pkt, sz + 1);
+	memset(DISP_DIRTY_X0, 0x00, sizeof(DISP_DIRTY_X0));
+	memset(DISP_DIRTY_X1, SSD1306_W-1, sizeof(DISP_DIRTY_X1));
 }
 
 /*
- * set the buffer to a color
+ * mark a clipped rectangle of the buffer as modified
  */
-void ssd1306_setbuf(uint8_t color)
+void ssd1306_mark_dirty(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
-	memset(ssd1306_buffer, color ? 0xFF : 0x00, 
-		SSD1306_W * SSD1306_H / 8);
+	uint32_t page, x1, p1;
+
+	// clipping
+	if((x >= SSD1306_W) || (y >= SSD1306_H) || !w || !h) return;
+	x1 = (w > SSD1306_W - x) ? SSD1306_W-1 : x+w-1;
+	p1 = (h > SSD1306_H - y) ? SSD1306_PAGES-1 : (y+h-1)/8;
+
+	for(page=y/8;page<=p1;page++)
+		ssd1306_dirty_span(page, x, x1);
 }
+// target-relative coordinates equal frame buffer ones whenever TARGET_DIRTY is set
+#define SSD1306_DIRTY_SPAN(page, x0, x1) do { if(TARGET_DIRTY) ssd1306_dirty_span(page, x0, x1); } while(0)
+#define SSD1306_DIRTY_RECT(x, y, w, h) do { if(TARGET_DIRTY) ssd1306_mark_dirty(x, y, w, h); } while(0)
+#else
+#define SSD1306_DIRTY_SPAN(page, x0, x1) do { } while(0)
+#define SSD1306_DIRTY_RECT(x, y, w, h) do { } while(0)
+#endif
+
+// CRC-32 (reflected 0xEDB88320) nibble table
+static const uint32_t ssd1306_crc_tab[16] =
+{
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+	0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+	0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
 
 /*
- * Send the frame buffer
+ * CRC-32 a nibble at a time (no multiply, the CH32V003 has no hardware
+ * multiplier), used to detect changed frames and pages; unlike a simple
+ * hash it catches every change confined to 4 consecutive bytes
  */
-void ssd1306_refresh(i2c_device_t *dev)
+static uint32_t ssd1306_hash(uint32_t h, const uint8_t *data, uint32_t sz)
 {
-	uint32_t i;
-
-	ssd1306_cmd(dev, SSD1306_COLUMNADDR);
-	ssd1306_cmd(dev, SSD1306_OFFSET);   // Column start address (0 = reset)
-	ssd1306_cmd(dev, SSD1306_OFFSET+SSD1306_W-1); // Column end address (127 = reset)
-	
-	ssd1306_cmd(dev, SSD1306_PAGEADDR);
-	ssd1306_cmd(dev, 0); // Page start address (0 = reset)
-	ssd1306_cmd(dev, 7); // Page end address
-
-	/* for fully used rows just plow thru everything */
-    for(i=0;i<sizeof(ssd1306_buffer);i+=SSD1306_PSZ)
+	while(sz--)
 	{
-		/* send PSZ block of data */
-		ssd1306_data(dev, &ssd1306_buffer[i], SSD1306_PSZ);
+		h ^= *data++;
+		h = (h >> 4) ^ ssd1306_crc_tab[h & 15];
+		h = (h >> 4) ^ ssd1306_crc_tab[h & 15];
 	}
+	return h;
 }
+#define SSD1306_HASH_INIT 0xFFFFFFFFu
 
+#if SSD1306_PAGE_HASH
 /*
- * plot a pixel in the buffer
+ * forget the page hashes so the next refresh sends every page
  */
-void ssd1306_drawPixel(uint32_t x, uint32_t y, int color)
+void ssd1306_refresh_invalidate(void)
 {
-	uint32_t addr;
-	
-	/* clip */
-	if(x >= SSD1306_W)
-		return;
-	if(y >= SSD1306_H)
-		return;
-	
-	/* compute buffer address */
-	addr = x + SSD1306_W*(y/8);
-	
-	/* set/clear bit in buffer */
-	if(color)
-		ssd1306_buffer[addr] |= (1<<(y&7));
-	else
-		ssd1306_buffer[addr] &= ~(1<<(y&7));
+	DISP_HASH_VALID = 0;
 }
+#endif
 
 /*
- * plot a pixel in the buffer
+ * reset is not used for SSD1306 I2C interface
  */
-void ssd1306_xorPixel(uint32_t x, uint32_t y)
+void ssd1306_rst(void)
 {
-	uint32_t addr;
-	
-	/* clip */
-	if(x >= SSD1306_W)
-		return;
-	if(y >= SSD1306_H)
-		return;
-	
-	/* compute buffer address */
-	addr = x + SSD1306_W*(y/8);
-	
-	ssd1306_buffer[addr] ^= (1<<(y&7));
 }
 
+#if SSD1306_STATS
+// driver statistics
+ssd1306_stats_t ssd1306_stats;
+
 /*
- * draw a an image from an array, directly into to the display buffer
- * the color modes allow for overwriting and even layering (sprites!)
+ * zero all statistics
  */
-void ssd1306_drawImage(uint32_t x, uint32_t y, const unsigned char* input, uint32_t width, uint32_t height, uint32_t color_mode) {
-	uint32_t x_absolute;
-	uint32_t y_absolute;
-	uint32_t pixel;
-	uint32_t bytes_to_draw = width / 8;
-	uint32_t buffer_addr;
+void ssd1306_stats_reset(void)
+{
+	memset(&ssd1306_stats, 0, sizeof(ssd1306_stats));
+}
+#define SSD1306_STAT_ADD(field, n) (ssd1306_stats.field += (n))
+#else
+#define SSD1306_STAT_ADD(field, n) ((void)0)
+#endif
 
-	for (uint32_t line = 0; line < height; line++) {
-		y_absolute = y + line;
-		if (y_absolute >= SSD1306_H) {
-			break;
-		}
+#if SSD1306_STATS_TIMING
+#define SSD1306_TIME_START() uint32_t ssd1306_t0 = SysTick->CNT
+#define SSD1306_TIME_END(field) (ssd1306_stats.field += SysTick->CNT - ssd1306_t0)
+#else
+#define SSD1306_TIME_START() do { } while(0)
+#define SSD1306_TIME_END(field) ((void)0)
+#endif
 
-		// SSD1306 is in vertical mode, yet we want to draw horizontally, which necessitates assembling the output bytes from the input data
-		// bitmask for current pixel in vertical (output) byte
-		uint32_t v_mask = 1 << (y_absolute & 7);
+#if SSD1306_USE_IRQ
+// set while the I2C interrupt owns the bus
+static volatile uint8_t ssd1306_q_busy;
+#endif
 
-		for (uint32_t byte = 0; byte < bytes_to_draw; byte++) {
-			uint32_t input_byte = input[byte + line * bytes_to_draw];
+#if SSD1306_CLOCK_ADAPT
+// clock steps above the rate the bus was started at
+static const uint32_t ssd1306_clock_steps[] = {
+	I2C_CLK_400KHZ, I2C_CLK_500KHZ, I2C_CLK_600KHZ, I2C_CLK_750KHZ, I2C_CLK_1MHZ
+};
+#define SSD1306_CLOCK_STEPS (sizeof(ssd1306_clock_steps) / sizeof(ssd1306_clock_steps[0]))
 
-			for (pixel = 0; pixel < 8; pixel++) {
-				x_absolute = x + 8 * (bytes_to_draw - byte) + pixel;
-				if (x_absolute >= SSD1306_W) {
-					break;
-				}
-				// looking at the horizontal display, we're drawing bytes bottom to top, not left to right, hence y / 8
-				buffer_addr = x_absolute + SSD1306_W * (y_absolute / 8);
-				// state of current pixel
-				uint8_t input_pixel = input_byte & (1 << pixel);
-
-				switch (color_mode) {
-					case 0:
-						// write pixels as they are
-						ssd1306_buffer[buffer_addr] = (ssd1306_buffer[buffer_addr] & ~v_mask) | (input_pixel ? v_mask : 0);
-						break;
-					case 1:
-						// write pixels after inversion
-						ssd1306_buffer[buffer_addr] = (ssd1306_buffer[buffer_addr] & ~v_mask) | (!input_pixel ? v_mask : 0);
-						break;
-					case 2:
-						// 0 clears pixel
-						ssd1306_buffer[buffer_addr] &= input_pixel ? 0xFF : ~v_mask;
-						break;
-					case 3:
-						// 1 sets pixel
-						ssd1306_buffer[buffer_addr] |= input_pixel ? v_mask : 0;
-						break;
-					case 4:
-						// 0 sets pixel
-						ssd1306_buffer[buffer_addr] |= !input_pixel ? v_mask : 0;
-						break;
-					case 5:
-						// 1 clears pixel
-						ssd1306_buffer[buffer_addr] &= input_pixel ? ~v_mask : 0xFF;
-						break;
-				}
-			}
-			#if SSD1306_LOG_IMAGE == 1
-			printf("%02x ", input_byte);
-			#endif
-		}
-		#if SSD1306_LOG_IMAGE == 1
-		printf("\n\r");
-		#endif
-	}
+// rate ssd1306_clock_calibrate() started from, never dropped below
+static uint32_t ssd1306_clk_base;
+// first step above the base, steps in use above it, failures in a row
+static uint8_t ssd1306_clk_first, ssd1306_clk_up, ssd1306_clk_fails;
+
+/*
+ * clock with n steps above the base rate
+ */
+static uint32_t ssd1306_clock_rate(uint8_t n)
+{
+	return n ? ssd1306_clock_steps[ssd1306_clk_first + n - 1] : ssd1306_clk_base;
 }
 
 /*
- *  fast vert line
+ * count failed transactions, go one step slower after too many in a row
  */
-void ssd1306_drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color)
+static void ssd1306_clock_feedback(i2c_device_t *dev, i2c_err_t err)
 {
-	// clipping
-	if((x >= SSD1306_W) || (y >= SSD1306_H)) return;
-	if((y+h-1) >= SSD1306_H) h = SSD1306_H-y;
-	while(h--)
+	if(err == I2C_OK)
 	{
-        ssd1306_drawPixel(x, y++, color);
+		ssd1306_clk_fails = 0;
+		return;
 	}
+	if(!ssd1306_clk_up || ++ssd1306_clk_fails < SSD1306_CLOCK_FALLBACK)
+		return;
+
+	ssd1306_clk_fails = 0;
+	ssd1306_clk_up--;
+	dev->clkr = ssd1306_clock_rate(ssd1306_clk_up);
+	i2c_init(dev);
+	SSD1306_STAT_ADD(clock_drops, 1);
 }
+#endif
 
 /*
- *  fast horiz line
+ * one I2C transaction: control byte (0x00 commands, 0x40 data) and payload
  */
-void ssd1306_drawFastHLine(uint32_t x, uint32_t y, uint32_t w, uint32_t color)
+static uint8_t ssd1306_write(i2c_device_t *dev, uint8_t ctrl, const uint8_t *buf, uint32_t sz)
 {
-	// clipping
-	if((x >= SSD1306_W) || (y >= SSD1306_H)) return;
-	if((x+w-1) >= SSD1306_W)  w = SSD1306_W-x;
+	i2c_err_t err;
+#if SSD1306_USE_IRQ
+	while(ssd1306_q_busy);
+#endif
+	SSD1306_TIME_START();
+
+	err = i2c_write_reg(dev, ctrl, buf, sz);
 
-	while (w--)
+	SSD1306_TIME_END(i2c_ticks);
+#if SSD1306_STATS
+	if(ctrl == 0x00)
+		ssd1306_stats.cmd_xfers++;
+	else
+		ssd1306_stats.data_xfers++;
+	ssd1306_stats.bytes += sz + 2;
+	if(err != I2C_OK)
 	{
-        ssd1306_drawPixel(x++, y, color);
+		ssd1306_stats.errors++;
+		if(err == I2C_ERR_NACK)
+			ssd1306_stats.nacks++;
+		else if(err == I2C_ERR_BUSY)
+			ssd1306_stats.timeouts++;
 	}
+#endif
+#if SSD1306_CLOCK_ADAPT
+	ssd1306_clock_feedback(dev, err);
+#endif
+	return (uint8_t)err;
 }
 
 /*
- * abs() helper function for line drawing
+ * send OLED command byte
  */
-int gfx_abs(int x)
+uint8_t ssd1306_cmd(i2c_device_t *dev, uint8_t cmd)
 {
-	return (x<0) ? -x : x;
+	return ssd1306_write(dev, 0x00, &cmd, 1);
 }
 
 /*
- * swap() helper function for line drawing
+ * send a list of OLED command bytes in a single transaction
  */
-void gfx_swap(int *z0, int *z1)
+uint8_t ssd1306_cmds(i2c_device_t *dev, const uint8_t *cmds, int sz)
 {
-	uint16_t temp = *z0;
-	*z0 = *z1;
-	*z1 = temp;
+	// register byte 0x00 = control byte, all following bytes are commands
+	return ssd1306_write(dev, 0x00, cmds, sz);
 }
 
+#if SSD1306_CLOCK_ADAPT
 /*
- * Bresenham line draw routine swiped from Wikipedia
+ * ramp the clock while NOP transactions keep getting through
  */
-void ssd1306_drawLine(int x0, int y0, int x1, int y1, uint32_t color)
+uint32_t ssd1306_clock_calibrate(i2c_device_t *dev, uint32_t max_hz)
 {
-	int32_t steep;
-	int32_t deltax, deltay, error, ystep, x, y;
-
-	/* flip sense 45deg to keep error calc in range */
-	steep = (gfx_abs(y1 - y0) > gfx_abs(x1 - x0));
+	uint8_t nop[SSD1306_PSZ];
+	uint8_t n, i;
 
-	if(steep)
-	{
-		gfx_swap(&x0, &y0);
-		gfx_swap(&x1, &y1);
-	}
+	memset(nop, SSD1306_NOP, sizeof(nop));
+	ssd1306_clk_base = dev->clkr;
+	ssd1306_clk_up = ssd1306_clk_fails = 0;
+	for(n = 0; n < SSD1306_CLOCK_STEPS && ssd1306_clock_steps[n] <= ssd1306_clk_base; n++);
+	ssd1306_clk_first = n;
 
-	/* run low->high */
-	if(x0 > x1)
+	// ssd1306_clk_up stays 0 here, so no failure triggers a fallback
+	for(n = 0; ssd1306_clk_first + n < SSD1306_CLOCK_STEPS; n++)
 	{
-		gfx_swap(&x0, &x1);
-		gfx_swap(&y0, &y1);
+		if(ssd1306_clock_steps[ssd1306_clk_first + n] > max_hz)
+			break;
+		dev->clkr = ssd1306_clock_steps[ssd1306_clk_first + n];
+		i2c_init(dev);
+		for(i = 0; i < SSD1306_CLOCK_TRIES; i++)
+			if(ssd1306_write(dev, 0x00, nop, sizeof(nop)) != I2C_OK)
+				break;
+		if(i < SSD1306_CLOCK_TRIES)
+			break;
 	}
 
-	/* set up loop initial conditions */
-	deltax = x1 - x0;
-	deltay = gfx_abs(y1 - y0);
-	error = deltax/2;
-	y = y0;
-	if(y0 < y1)
-		ystep = 1;
-	else
-		ystep = -1;
-
-	/* loop x */
-	for(x=x0;x<=x1;x++)
-	{
-		/* plot point */
-		if(steep)
-			/* flip point & plot */
-			ssd1306_drawPixel(y, x, color);
-		else
-			/* just plot */
-			ssd1306_drawPixel(x, y, color);
-
-		/* update error */
-		error = error - deltay;
-
-		/* update y */
-		if(error < 0)
-		{
-			y = y + ystep;
-			error = error + deltax;
-		}
-	}
+	ssd1306_clk_up = n;
+	dev->clkr = ssd1306_clock_rate(n);
+	i2c_init(dev);
+	return dev->clkr;
 }
+#endif
+
+// segment remap and COM scan direction set up by the init sequence
+#ifdef SH1107
+#define SSD1306_SEG_INIT SSD1306_SEGREMAP
+#define SSD1306_COM_INIT SSD1306_COMSCANINC
+#else
+#define SSD1306_SEG_INIT (SSD1306_SEGREMAP | 0x1)
+#define SSD1306_COM_INIT SSD1306_COMSCANDEC
+#endif
 
 /*
- *  draws a circle
+ * mirror columns and/or rows relative to the init orientation
  */
-void ssd1306_drawCircle(int x, int y, int radius, int color)
+uint8_t ssd1306_set_orientation(i2c_device_t *dev, uint8_t flags)
 {
-    /* Bresenham algorithm */
-    int x_pos = -radius;
-    int y_pos = 0;
-    int err = 2 - 2 * radius;
-    int e2;
+	uint8_t seg = SSD1306_SEG_INIT ^ ((flags & SSD1306_MIRROR_X) ? 0x1 : 0);
+	uint8_t com = SSD1306_COM_INIT ^ ((flags & SSD1306_MIRROR_Y) ? 0x8 : 0);
 
-    do {
-        ssd1306_drawPixel(x - x_pos, y + y_pos, color);
-        ssd1306_drawPixel(x + x_pos, y + y_pos, color);
-        ssd1306_drawPixel(x + x_pos, y - y_pos, color);
-        ssd1306_drawPixel(x - x_pos, y - y_pos, color);
-        e2 = err;
-        if (e2 <= y_pos) {
-            err += ++y_pos * 2 + 1;
-            if(-x_pos == y_pos && e2 <= x_pos) {
-              e2 = 0;
-            }
-        }
-        if (e2 > x_pos) {
-            err += ++x_pos * 2 + 1;
-        }
-    } while (x_pos <= 0);
+	/* the standard panels sit centred in the 128 RAM columns, so their
+	 * column offset still holds when mirrored */
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_all();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+	return ssd1306_cmds(dev, (uint8_t[]){seg, com}, 2);
 }
 
 /*
- *  draws a filled circle
+ * set the column/page address window (columns relative to the buffer)
  */
-void ssd1306_fillCircle(int x, int y, int radius, int color)
+static uint8_t ssd1306_window(i2c_device_t *dev, uint32_t x0, uint32_t x1, uint32_t p0, uint32_t p1)
 {
-    /* Bresenham algorithm */
-    int x_pos = -radius;
-    int y_pos = 0;
-    int err = 2 - 2 * radius;
-    int e2;
-
-    do {
-        ssd1306_drawPixel(x - x_pos, y + y_pos, color);
-        ssd1306_drawPixel(x + x_pos, y + y_pos, color);
-        ssd1306_drawPixel(x + x_pos, y - y_pos, color);
-        ssd1306_drawPixel(x - x_pos, y - y_pos, color);
-        ssd1306_drawFastHLine(x + x_pos, y + y_pos, 2 * (-x_pos) + 1, color);
-        ssd1306_drawFastHLine(x + x_pos, y - y_pos, 2 * (-x_pos) + 1, color);
-        e2 = err;
-        if (e2 <= y_pos) {
-            err += ++y_pos * 2 + 1;
-            if(-x_pos == y_pos && e2 <= x_pos) {
-                e2 = 0;
-            }
-        }
-        if(e2 > x_pos) {
-            err += ++x_pos * 2 + 1;
-        }
-    } while(x_pos <= 0);
+	return ssd1306_cmds(dev, (uint8_t[]){
+		SSD1306_COLUMNADDR, SSD1306_OFFSET+x0, SSD1306_OFFSET+x1,
+		SSD1306_PAGEADDR, p0, p1}, 6);
 }
 
+// bus bytes of an address window transaction
+#define SSD1306_WINDOW_BYTES (1 + 1 + 6)
+
+// controller RAM page a buffer page is sent to
+#define SSD1306_RAM_PAGE(p) (((p) + DISP_START_LINE/8) & (SSD1306_RAM_PAGES-1))
+
 /*
- *  draw a rectangle
+ * send OLED data packet (up to 32 bytes)
  */
-void ssd1306_drawRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color)
+uint8_t ssd1306_data(i2c_device_t *dev, uint8_t *data, int sz)
 {
-	ssd1306_drawFastVLine(x, y, h, color);
-	ssd1306_drawFastVLine(x+w-1, y, h, color);
-	ssd1306_drawFastHLine(x, y, w, color);
-	ssd1306_drawFastHLine(x, y+h-1, w, color);
+	if(sz > SSD1306_PSZ) sz = SSD1306_PSZ; // limit to max packet size
+
+	// register byte 0x40 = control byte, all following bytes are data
+	return ssd1306_write(dev, 0x40, data, sz);
 }
 
 /*
- * fill a rectangle
+ * send any amount of OLED data straight from the caller's buffer,
+ * in transactions of at most SSD1306_BURST bytes
  */
-void ssd1306_fillRect(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t color)
+uint8_t ssd1306_data_stream(i2c_device_t *dev, const uint8_t *data, uint32_t sz)
 {
-	uint32_t m, n=y, iw = w;
-	
-	/* scan vertical */
-	while(h--)
+	uint8_t err = 0;
+
+	while(sz)
 	{
-		m=x;
-		w=iw;
-		/* scan horizontal */
-		while(w--)
-		{
-			/* invert pixels */
-			ssd1306_drawPixel(m++, n, color);
-		}
-		n++;
+		uint32_t n = (sz > SSD1306_BURST) ? SSD1306_BURST : sz;
+		err |= ssd1306_write(dev, 0x40, data, n);
+		data += n;
+		sz -= n;
 	}
+	return err;
 }
 
+#if !SSD1306_ROTATE_90
 /*
- * invert a rectangle in the buffer
+ * send full-width pages to where they belong in controller RAM,
+ * splitting the window where it wraps around the end of RAM
  */
-void ssd1306_xorrect(uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+static uint8_t ssd1306_send_pages(i2c_device_t *dev, const uint8_t *data, uint32_t page, uint32_t pages)
 {
-	uint8_t m, n=y, iw = w;
-	
-	/* scan vertical */
-	while(h--)
+	uint32_t rp, n;
+	uint8_t err = 0;
+
+	while(pages)
 	{
-		m=x;
-		w=iw;
-		/* scan horizontal */
-		while(w--)
-		{
-			/* invert pixels */
-			ssd1306_xorPixel(m++, n);
-		}
-		n++;
+		rp = SSD1306_RAM_PAGE(page);
+		n = SSD1306_RAM_PAGES - rp;
+		if(n > pages) n = pages;
+
+		/* no data after a failed window, it would land wherever the cursor is */
+		if(ssd1306_window(dev, 0, SSD1306_W-1, rp, rp+n-1))
+			err = 1;
+		else
+			err |= ssd1306_data_stream(dev, data, SSD1306_W * n);
+		data += SSD1306_W * n;
+		page += n;
+		pages -= n;
 	}
+	return err;
 }
+#endif
 
 /*
- * Draw character to the display buffer
+ * set the buffer to a color
  */
-void ssd1306_drawchar(uint8_t x, uint8_t y, uint8_t chr, uint8_t color)
+void ssd1306_setbuf(uint8_t color)
 {
-	uint16_t i, j, col;
+	memset(TARGET_BUF, color ? 0xFF : 0x00, 
+		TARGET_W * TARGET_PAGES);
+#if SSD1306_DIRTY_TRACKING
+	if(TARGET_DIRTY)
+		ssd1306_dirty_all();
+#endif
+}
+
+#if SSD1306_ROTATE_90
+/*
+ * send the buffer turned by 90 degrees, transposing 8x8 blocks on the
+ * way out: panel column px shows buffer row SSD1306_PANEL_W-1-px
+ */
+static uint8_t ssd1306_send_rotated(i2c_device_t *dev)
+{
+	uint8_t tmp[SSD1306_PSZ];
+	const uint8_t *src;
+	uint32_t page = 0, end, rp, n, px, sz, i, j, v;
+	uint8_t err = 0;
+
+	while(page < SSD1306_PANEL_PAGES)
+	{
+		rp = SSD1306_RAM_PAGE(page);
+		n = SSD1306_RAM_PAGES - rp;
+		if(n > SSD1306_PANEL_PAGES - page) n = SSD1306_PANEL_PAGES - page;
+
+		/* no data after a failed window, it would land wherever the cursor is */
+		if(ssd1306_window(dev, 0, SSD1306_PANEL_W-1, rp, rp+n-1))
+		{
+			err = 1;
+			page += n;
+			continue;
+		}
+
+		for(end=page+n;page<end;page++)
+		{
+			/* panel page = 8 buffer columns, last buffer page first */
+			src = &DISP_BUF[8*page + SSD1306_W*(SSD1306_PAGES-1)];
+			for(px=0;px<SSD1306_PANEL_W;px+=sz)
+			{
+				sz = SSD1306_PANEL_W - px;
+				if(sz > SSD1306_PSZ) sz = SSD1306_PSZ;
+				memset(tmp, 0, sz);
+				for(j=0;j<sz;j+=8,src-=SSD1306_W)
+					for(i=0;i<8;i++)
+					{
+						/* buffer row bit k lands in panel column 7-k */
+						uint8_t *dst = &tmp[j+7];
+						for(v=src[i];v;v>>=1,dst--)
+							*dst |= (v & 1) << i;
+					}
+				err |= ssd1306_write(dev, 0x40, tmp, sz);
+			}
+		}
+	}
+	return err;
+}
+#endif
+
+#if SSD1306_FRAMEBUFFER
+/*
+ * Send the frame buffer
+ */
+uint8_t ssd1306_refresh(i2c_device_t *dev)
+{
+	uint8_t err = 0;
+#if SSD1306_ROTATE_90
+	err = ssd1306_send_rotated(dev);
+#elif SSD1306_PAGE_HASH
+	uint32_t page, h;
+
+	for(page=0;page<SSD1306_PAGES;page++)
+	{
+		/* skip pages identical to what was last sent */
+		h = ssd1306_hash(SSD1306_HASH_INIT, &DISP_BUF[SSD1306_W*page], SSD1306_W);
+		if((DISP_HASH_VALID & (1u<<page)) && (DISP_HASH[page] == h))
+			continue;
+
+		if(ssd1306_send_pages(dev, &DISP_BUF[SSD1306_W*page], page, 1))
+		{
+			DISP_HASH_VALID &= ~(1u<<page);
+			err = 1;
+			continue;
+		}
+		DISP_HASH[page] = h;
+		DISP_HASH_VALID |= 1u<<page;
+	}
+#else
+	/* for fully used rows just plow thru everything */
+	err = ssd1306_send_pages(dev, DISP_BUF, 0, SSD1306_PAGES);
+#endif
+
+	if(err)
+		return err;
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_clear();
+#endif
+	SSD1306_STAT_ADD(frames, 1);
+	return 0;
+}
+
+#if !SSD1306_ROTATE_90
+/*
+ * send the pages covering a rectangle: one address window, then the
+ * buffer row by row since the window is narrower than the buffer
+ */
+uint8_t ssd1306_refresh_rect(i2c_device_t *dev, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	uint32_t page, last, rp, n;
+	uint8_t err = 0, werr;
+
+	if(x < 0) { w += x; x = 0; }
+	if(y < 0) { h += y; y = 0; }
+	if((w <= 0) || (h <= 0) || (x >= SSD1306_W) || (y >= SSD1306_H))
+		return 0;
+	if(w > SSD1306_W - x) w = SSD1306_W - x;
+	if(h > SSD1306_H - y) h = SSD1306_H - y;
+
+	page = y/8;
+	last = (y+h-1)/8;
+	while(page <= last)
+	{
+		/* split only where the window wraps around the end of RAM */
+		rp = SSD1306_RAM_PAGE(page);
+		n = SSD1306_RAM_PAGES - rp;
+		if(n > last - page + 1) n = last - page + 1;
+		werr = ssd1306_window(dev, x, x+w-1, rp, rp+n-1);
+
+		for(;n;n--,page++)
+		{
+#if SSD1306_PAGE_HASH
+			DISP_HASH_VALID &= ~(1u<<page);
+#endif
+			/* after a failure the window position is unknown, skip the rest */
+			if(werr || ssd1306_data_stream(dev, &DISP_BUF[x + SSD1306_W*page], w))
+			{
+				err = werr = 1;
+				continue;
+			}
+#if SSD1306_DIRTY_TRACKING
+			/* the page is clean if all of its changes were inside */
+			if((DISP_DIRTY_X0[page] >= x) && (DISP_DIRTY_X1[page] <= x+w-1))
+			{
+				DISP_DIRTY_X0[page] = 0xFF;
+				DISP_DIRTY_X1[page] = 0x00;
+			}
+#endif
+		}
+	}
+	return err;
+}
+#endif
+#endif
+
+#if SSD1306_STRIP_PAGES
+/*
+ * render the frame strip by strip into the strip buffer and send each
+ * strip before drawing the next one
+ */
+uint8_t ssd1306_render_strips(i2c_device_t *dev, ssd1306_draw_cb_t draw, void *arg)
+{
+	ssd1306_target_t saved = ssd1306_target;
+	uint32_t page, pages;
+	uint8_t err = 0;
+
+	ssd1306_target.buf = ssd1306_strip;
+	ssd1306_target.dirty = 0;
+	ssd1306_target.w = SSD1306_W;
+
+	for(page=0;page<SSD1306_PAGES;page+=pages)
+	{
+		pages = SSD1306_PAGES - page;
+		if(pages > SSD1306_STRIP_PAGES) pages = SSD1306_STRIP_PAGES;
+		ssd1306_target.y0 = page * 8;
+		ssd1306_target.pages = pages;
+
+		memset(ssd1306_strip, 0, SSD1306_W * pages);
+		if(draw)
+		{
+			SSD1306_TIME_START();
+			draw(arg);
+			SSD1306_TIME_END(render_ticks);
+		}
+
+		err |= ssd1306_send_pages(dev, ssd1306_strip, page, pages);
+	}
+
+	ssd1306_target = saved;
+	/* the panel no longer shows the frame buffer */
+#if SSD1306_FRAMEBUFFER && SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_all();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+	if(!err)
+		SSD1306_STAT_ADD(frames, 1);
+	return err;
+}
+#endif
+
+#if SSD1306_DIRTY_TRACKING
+/*
+ * Send only the modified column span of each page
+ */
+uint8_t ssd1306_refresh_dirty(i2c_device_t *dev)
+{
+	uint32_t page, x0, sz;
+	uint8_t err = 0;
+
+	for(page=0;page<SSD1306_PAGES;page++)
+	{
+		x0 = DISP_DIRTY_X0[page];
+		if(x0 > DISP_DIRTY_X1[page])
+			continue;
+		sz = DISP_DIRTY_X1[page] - x0 + 1;
+
+#if SSD1306_PAGE_HASH
+		// rest of the page may differ from its hash now
+		DISP_HASH_VALID &= ~(1u<<page);
+#endif
+
+		/* address window covering just the dirty span, kept dirty on failure */
+		if(ssd1306_window(dev, x0, x0+sz-1, SSD1306_RAM_PAGE(page), SSD1306_RAM_PAGE(page)) ||
+			ssd1306_data_stream(dev, &DISP_BUF[x0 + SSD1306_W*page], sz))
+		{
+			err = 1;
+			continue;
+		}
+		DISP_DIRTY_X0[page] = 0xFF;
+		DISP_DIRTY_X1[page] = 0x00;
+	}
+
+	if(!err)
+		SSD1306_STAT_ADD(frames, 1);
+	return err;
+}
+
+/*
+ * check for modified spans not sent yet
+ */
+uint8_t ssd1306_refresh_pending(void)
+{
+	uint32_t page;
+
+	for(page=0;page<SSD1306_PAGES;page++)
+		if(DISP_DIRTY_X0[page] <= DISP_DIRTY_X1[page])
+			return 1;
+	return 0;
+}
+
+/*
+ * send the next max data bytes of the dirty spans, starting where the
+ * previous packet stopped; sent columns leave the span, so drawing between
+ * packets simply widens what is still to be sent. Each packet sets its own
+ * window, so it does not matter what went to the panel in between.
+ * Returns the bus bytes used, 0 when nothing is dirty.
+ */
+static uint32_t ssd1306_dirty_packet(i2c_device_t *dev, uint32_t max, uint8_t *err)
+{
+	uint32_t i, page = DISP_PKT_PAGE, next, x0, sz;
+
+	for(i=0;i<SSD1306_PAGES;i++)
+	{
+		if(DISP_DIRTY_X0[page] <= DISP_DIRTY_X1[page])
+			break;
+		page = (page+1 < SSD1306_PAGES) ? page+1 : 0;
+	}
+	if(i == SSD1306_PAGES)
+		return 0;
+	next = (page+1 < SSD1306_PAGES) ? page+1 : 0;
+
+	x0 = DISP_DIRTY_X0[page];
+	sz = DISP_DIRTY_X1[page] - x0 + 1;
+	if(sz > max) sz = max;
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID &= ~(1u<<page);
+#endif
+
+	if(ssd1306_window(dev, x0, x0+sz-1, SSD1306_RAM_PAGE(page), SSD1306_RAM_PAGE(page)) ||
+		ssd1306_data_stream(dev, &DISP_BUF[x0 + SSD1306_W*page], sz))
+	{
+		/* stays dirty, try the other pages first */
+		*err = 1;
+		page = next;
+	}
+	else if(x0 + sz > DISP_DIRTY_X1[page])
+	{
+		DISP_DIRTY_X0[page] = 0xFF;
+		DISP_DIRTY_X1[page] = 0x00;
+		page = next;
+	}
+	else
+		DISP_DIRTY_X0[page] = x0 + sz;
+
+	DISP_PKT_PAGE = page;
+	return SSD1306_WINDOW_BYTES + 2 + sz;
+}
+
+/*
+ * send dirty packets until the byte budget is used up, at least one
+ * (possibly shortened) packet so that every call makes progress
+ */
+uint8_t ssd1306_refresh_step(i2c_device_t *dev, uint32_t budget)
+{
+	uint32_t max, used;
+	uint8_t err = 0;
+
+	do
+	{
+		max = (budget > SSD1306_WINDOW_BYTES + 2) ? budget - (SSD1306_WINDOW_BYTES + 2) : 1;
+		if(max > SSD1306_BURST) max = SSD1306_BURST;
+
+		used = ssd1306_dirty_packet(dev, max, &err);
+		if(!used)
+			return err;
+		budget = (budget > used) ? budget - used : 0;
+	}
+	while(budget > SSD1306_WINDOW_BYTES + 2);
+
+	if(!ssd1306_refresh_pending())
+		SSD1306_STAT_ADD(frames, 1);
+	return err;
+}
+
+/*
+ * microsecond budget converted to bytes at the nominal bus clock,
+ * 9 bit times per byte
+ */
+uint8_t ssd1306_refresh_step_us(i2c_device_t *dev, uint32_t us)
+{
+	return ssd1306_refresh_step(dev, us / 9 * (dev->clkr / 1000) / 1000);
+}
+#endif
+
+#if SSD1306_MULTI
+/*
+ * set up a display context, everything marked for sending
+ */
+void ssd1306_disp_init(ssd1306_disp_t *d, i2c_device_t *dev, uint8_t *buf)
+{
+	memset(d, 0, sizeof(*d));
+	d->dev = dev;
+	d->buf = buf;
+#if SSD1306_DIRTY_TRACKING
+	memset(d->dirty_x1, SSD1306_W-1, sizeof(d->dirty_x1));
+#endif
+}
+
+/*
+ * make a display the one drawn to and refreshed
+ */
+void ssd1306_select(ssd1306_disp_t *d)
+{
+#if SSD1306_STRIP_PAGES || SSD1306_CANVAS
+	// follow along unless a strip or canvas is being drawn
+	if(ssd1306_target.buf == ssd1306_disp->buf)
+		ssd1306_target.buf = d->buf;
+#endif
+#if SSD1306_CANVAS
+	// and return to the new display after the canvas
+	if(ssd1306_canvas_on && (ssd1306_canvas_prev.buf == ssd1306_disp->buf))
+		ssd1306_canvas_prev.buf = d->buf;
+#endif
+	ssd1306_disp = d;
+}
+
+/*
+ * the display drawn to and refreshed
+ */
+ssd1306_disp_t *ssd1306_selected(void)
+{
+	return ssd1306_disp;
+}
+
+#if SSD1306_DIRTY_TRACKING
+// display the next scheduler round starts with
+static uint8_t ssd1306_sched_next;
+
+/*
+ * send up to the given number of dirty packets, taking turns between
+ * the displays so a big refresh on one cannot starve the others
+ */
+uint8_t ssd1306_sched_run(ssd1306_disp_t *const *disp, uint32_t n, uint32_t packets)
+{
+	ssd1306_disp_t *saved = ssd1306_disp;
+	uint32_t idle = 0, i;
+	uint8_t err = 0;
+
+	if(ssd1306_sched_next >= n)
+		ssd1306_sched_next = 0;
+
+	/* stop once every display had a turn with nothing to send */
+	while(packets && (idle < n))
+	{
+		i = ssd1306_sched_next;
+		ssd1306_sched_next = (i+1 < n) ? i+1 : 0;
+
+		ssd1306_disp = disp[i];
+		if(!ssd1306_dirty_packet(disp[i]->dev, SSD1306_BURST, &err))
+		{
+			idle++;
+			continue;
+		}
+		idle = 0;
+		packets--;
+		if(!ssd1306_refresh_pending())
+			SSD1306_STAT_ADD(frames, 1);
+	}
+
+	ssd1306_disp = saved;
+	return err;
+}
+#endif
+#endif
+
+#if SSD1306_USE_DMA
+// asynchronous refresh state, shared with the DMA interrupt
+static volatile uint8_t ssd1306_dma_busy;
+static volatile uint8_t ssd1306_dma_err;
+static ssd1306_refresh_cb_t ssd1306_dma_cb;
+static uint32_t ssd1306_dma_tout;
+
+/*
+ * wait for an I2C1 status flag, 0 on success
+ */
+static uint8_t ssd1306_i2c_wait(uint16_t flag, uint32_t tout)
+{
+	while(!(I2C1->STAR1 & flag))
+	{
+		if(I2C1->STAR1 & (I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO))
+			return 1;
+		if(!tout--)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * abort a transfer, release the bus and report completion
+ */
+static void ssd1306_dma_finish(uint8_t err)
+{
+	DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+	I2C1->CTLR2 &= ~I2C_CTLR2_DMAEN;
+	I2C1->STAR1 &= ~(I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO);
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+
+	ssd1306_dma_err = err;
+	ssd1306_dma_busy = 0;
+	if(err)
+		SSD1306_STAT_ADD(errors, 1);
+	else
+		SSD1306_STAT_ADD(frames, 1);
+	if(ssd1306_dma_cb)
+		ssd1306_dma_cb(err);
+}
+
+/*
+ * hand the payload of the transaction in progress to DMA, the control
+ * byte must already be in the data register
+ */
+static void ssd1306_dma_arm(const uint8_t *buf, uint32_t sz)
+{
+	RCC->AHBPCENR |= RCC_AHBPeriph_DMA1;
+	NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+	DMA1->INTFCR = DMA1_IT_GL6;
+	DMA1_Channel6->CFGR = 0;
+	DMA1_Channel6->PADDR = (uint32_t)&I2C1->DATAR;
+	DMA1_Channel6->MADDR = (uint32_t)buf;
+	DMA1_Channel6->CNTR = sz;
+	DMA1_Channel6->CFGR = DMA_CFGR1_DIR | DMA_CFGR1_MINC | DMA_CFGR1_PL_1 |
+		DMA_CFGR1_TCIE | DMA_CFGR1_TEIE | DMA_CFGR1_EN;
+	I2C1->CTLR2 |= I2C_CTLR2_DMAEN;
+}
+
+#if SSD1306_USE_IRQ
+static volatile uint8_t ssd1306_q_dma;
+static void ssd1306_queue_dma_done(uint8_t err);
+#endif
+
+/*
+ * DMA transfer complete - wait for the last byte to leave the shift
+ * register (at most two byte times) then close the transaction
+ */
+void DMA1_Channel6_IRQHandler(void) INTERRUPT_DECORATOR;
+void DMA1_Channel6_IRQHandler(void)
+{
+	uint32_t intfr = DMA1->INTFR;
+
+	DMA1->INTFCR = DMA1_IT_GL6;
+#if SSD1306_USE_IRQ
+	if(ssd1306_q_dma)
+	{
+		ssd1306_queue_dma_done(intfr & DMA1_FLAG_TE6);
+		return;
+	}
+#endif
+	if(intfr & DMA1_FLAG_TE6)
+	{
+		ssd1306_dma_finish(1);
+		return;
+	}
+	ssd1306_dma_finish(ssd1306_i2c_wait(I2C_STAR1_BTF, ssd1306_dma_tout));
+}
+
+/*
+ * start a DMA refresh of the frame buffer in a single I2C transaction
+ */
+uint8_t ssd1306_refresh_start(i2c_device_t *dev, ssd1306_refresh_cb_t cb)
+{
+	uint32_t tout = dev->tout;
+
+	if(ssd1306_dma_busy)
+		return 1;
+#if SSD1306_USE_IRQ
+	if(ssd1306_q_busy)
+		return 1;
+#endif
+
+	/* address window (polled, only a few bytes), must not wrap in RAM */
+	if(SSD1306_RAM_PAGE(0) + SSD1306_PAGES > SSD1306_RAM_PAGES)
+		return 1;
+	if(ssd1306_window(dev, 0, SSD1306_W-1, SSD1306_RAM_PAGE(0), SSD1306_RAM_PAGE(0)+SSD1306_PAGES-1))
+		return 1;
+
+	/* START, address, control byte - polled */
+	while((I2C1->STAR2 & I2C_STAR2_BUSY) && tout) tout--;
+	if(I2C1->STAR2 & I2C_STAR2_BUSY)
+	{
+		/* stuck bus: leave START and DMA alone, nothing would complete */
+		SSD1306_STAT_ADD(errors, 1);
+		SSD1306_STAT_ADD(timeouts, 1);
+#if SSD1306_CLOCK_ADAPT
+		ssd1306_clock_feedback(dev, I2C_ERR_BUSY);
+#endif
+		return I2C_ERR_BUSY;
+	}
+	I2C1->CTLR1 |= I2C_CTLR1_START;
+	if(ssd1306_i2c_wait(I2C_STAR1_SB, dev->tout))
+		goto fail;
+	I2C1->DATAR = dev->addr << 1;
+	if(ssd1306_i2c_wait(I2C_STAR1_ADDR, dev->tout))
+		goto fail;
+	(void)I2C1->STAR2; // clears ADDR
+	I2C1->DATAR = 0x40;
+	if(ssd1306_i2c_wait(I2C_STAR1_TXE, dev->tout))
+		goto fail;
+
+	/* hand the payload to DMA */
+	ssd1306_dma_cb = cb;
+	ssd1306_dma_tout = dev->tout;
+	ssd1306_dma_err = 0;
+	ssd1306_dma_busy = 1;
+	SSD1306_STAT_ADD(data_xfers, 1);
+	SSD1306_STAT_ADD(bytes, SSD1306_FB_SIZE + 2);
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_clear();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+	ssd1306_dma_arm(DISP_BUF, SSD1306_FB_SIZE);
+	return 0;
+
+fail:
+	SSD1306_STAT_ADD(errors, 1);
+	I2C1->STAR1 &= ~(I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO);
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+#if SSD1306_CLOCK_ADAPT
+	ssd1306_clock_feedback(dev, I2C_ERR_BUSY);
+#endif
+	return 1;
+}
+
+/*
+ * poll for asynchronous refresh completion
+ */
+uint8_t ssd1306_refresh_busy(void)
+{
+	return ssd1306_dma_busy;
+}
+
+/*
+ * block until the asynchronous refresh is done
+ */
+uint8_t ssd1306_refresh_wait(void)
+{
+	while(ssd1306_dma_busy);
+	return ssd1306_dma_err;
+}
+#endif
+
+#if SSD1306_USE_IRQ
+// transmit queue entry, one I2C transaction
+typedef struct {
+	const uint8_t *buf;     // payload, NULL for the bytes in cmd
+	uint16_t len;
+	uint8_t addr;           // 7-bit device address
+	uint8_t ctrl;           // control byte, 0x00 commands, 0x40 data
+	uint8_t chain;          // dropped when the transaction before it fails
+	uint8_t cmd[6];          // inline commands (address window)
+} ssd1306_qdesc_t;
+
+// ring of descriptors: head is only advanced by the caller, tail by the
+// interrupt, both run freely and are masked on access
+static ssd1306_qdesc_t ssd1306_q[SSD1306_QUEUE_LEN];
+static volatile uint32_t ssd1306_q_head, ssd1306_q_tail;
+static uint32_t ssd1306_q_new;      // written but not yet handed to the interrupt
+static uint32_t ssd1306_q_pos;      // payload bytes of the current entry sent
+static volatile uint8_t ssd1306_q_err;
+
+#define SSD1306_Q_AT(i) (&ssd1306_q[(i) & (SSD1306_QUEUE_LEN-1)])
+
+/*
+ * start the transaction at the tail, the interrupt takes it from there
+ */
+static void ssd1306_queue_start(void)
+{
+	ssd1306_q_pos = 0;
+	I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITBUFEN | I2C_CTLR2_ITERREN;
+	I2C1->CTLR1 |= I2C_CTLR1_START;
+}
+
+/*
+ * close the current transaction and start the next one, or give the
+ * bus back to the blocking calls when the queue is empty
+ */
+static void ssd1306_queue_next(uint8_t err)
+{
+	const ssd1306_qdesc_t *d = SSD1306_Q_AT(ssd1306_q_tail);
+	uint32_t tail = ssd1306_q_tail + 1;
+
+#if SSD1306_USE_DMA
+	if(ssd1306_q_dma)
+	{
+		DMA1_Channel6->CFGR &= ~DMA_CFGR1_EN;
+		DMA1->INTFCR = DMA1_IT_GL6;
+		I2C1->CTLR2 &= ~I2C_CTLR2_DMAEN;
+		ssd1306_q_dma = 0;
+	}
+#endif
+	I2C1->STAR1 &= ~(I2C_STAR1_AF | I2C_STAR1_BERR | I2C_STAR1_ARLO);
+	I2C1->CTLR1 |= I2C_CTLR1_STOP;
+
+	if(d->ctrl == 0x00)
+		SSD1306_STAT_ADD(cmd_xfers, 1);
+	else
+		SSD1306_STAT_ADD(data_xfers, 1);
+	SSD1306_STAT_ADD(bytes, d->len + 2);
+	if(err)
+	{
+		/* the rest of the call would land in the wrong place */
+		SSD1306_STAT_ADD(errors, 1);
+		ssd1306_q_err = 1;
+		while(tail != ssd1306_q_head && SSD1306_Q_AT(tail)->chain)
+			tail++;
+	}
+	ssd1306_q_tail = tail;
+
+	if(tail != ssd1306_q_head)
+		ssd1306_queue_start();
+	else
+	{
+		I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITBUFEN | I2C_CTLR2_ITERREN);
+		ssd1306_q_busy = 0;
+	}
+}
+
+#if SSD1306_USE_DMA
+/*
+ * payload sent by DMA, BTF in the event interrupt ends the transaction
+ */
+static void ssd1306_queue_dma_done(uint8_t err)
+{
+	if(err)
+	{
+		ssd1306_queue_next(1);
+		return;
+	}
+	ssd1306_q_pos = SSD1306_Q_AT(ssd1306_q_tail)->len;
+	I2C1->CTLR2 |= I2C_CTLR2_ITEVTEN;
+}
+#endif
+
+/*
+ * I2C events of the transaction at the tail: start sent, address
+ * acknowledged, data register empty, last byte shifted out
+ */
+void I2C1_EV_IRQHandler(void) INTERRUPT_DECORATOR;
+void I2C1_EV_IRQHandler(void)
+{
+	const ssd1306_qdesc_t *d = SSD1306_Q_AT(ssd1306_q_tail);
+	const uint8_t *src = d->buf ? d->buf : d->cmd;
+	uint16_t star1 = I2C1->STAR1;
+
+	if(star1 & I2C_STAR1_SB)
+		I2C1->DATAR = d->addr << 1;
+	else if(star1 & I2C_STAR1_ADDR)
+	{
+		(void)I2C1->STAR2; // clears ADDR
+		I2C1->DATAR = d->ctrl;
+#if SSD1306_USE_DMA
+		if(d->ctrl == 0x40)
+		{
+			I2C1->CTLR2 &= ~(I2C_CTLR2_ITEVTEN | I2C_CTLR2_ITBUFEN);
+			ssd1306_q_dma = 1;
+			ssd1306_dma_arm(src, d->len);
+		}
+#endif
+	}
+	else if(ssd1306_q_pos < d->len)
+	{
+		if(star1 & I2C_STAR1_TXE)
+			I2C1->DATAR = src[ssd1306_q_pos++];
+	}
+	else if(star1 & I2C_STAR1_BTF)
+		ssd1306_queue_next(0);
+	else
+		I2C1->CTLR2 &= ~I2C_CTLR2_ITBUFEN; // all written, wait for BTF
+}
+
+/*
+ * not acknowledged, bus error or lost arbitration
+ */
+void I2C1_ER_IRQHandler(void) INTERRUPT_DECORATOR;
+void I2C1_ER_IRQHandler(void)
+{
+	if(I2C1->STAR1 & I2C_STAR1_AF)
+		SSD1306_STAT_ADD(nacks, 1);
+	ssd1306_queue_next(1);
+}
+
+/*
+ * check that n more descriptors fit, none while a DMA refresh owns the bus
+ */
+static uint8_t ssd1306_queue_room(uint32_t n)
+{
+#if SSD1306_USE_DMA
+	if(ssd1306_dma_busy)
+		return 0;
+#endif
+	return ssd1306_queue_free() >= n;
+}
+
+/*
+ * fill in the next unpublished descriptor
+ */
+static ssd1306_qdesc_t *ssd1306_queue_add(i2c_device_t *dev, uint8_t ctrl, const uint8_t *buf, uint32_t sz)
+{
+	ssd1306_qdesc_t *d = SSD1306_Q_AT(ssd1306_q_head + ssd1306_q_new);
+
+	d->buf = buf;
+	d->len = sz;
+	d->addr = dev->addr;
+	d->ctrl = ctrl;
+	d->chain = (ssd1306_q_new != 0);
+	ssd1306_q_new++;
+	return d;
+}
+
+/*
+ * hand the new descriptors to the interrupt, starting it when idle
+ */
+static void ssd1306_queue_commit(void)
+{
+	NVIC_DisableIRQ(I2C1_EV_IRQn);
+	NVIC_DisableIRQ(I2C1_ER_IRQn);
+	ssd1306_q_head += ssd1306_q_new;
+	ssd1306_q_new = 0;
+	if(!ssd1306_q_busy)
+	{
+		ssd1306_q_busy = 1;
+		ssd1306_queue_start();
+	}
+	NVIC_EnableIRQ(I2C1_EV_IRQn);
+	NVIC_EnableIRQ(I2C1_ER_IRQn);
+}
+
+/*
+ * queue a transaction from the caller's buffer
+ */
+static uint8_t ssd1306_queue_xfer(i2c_device_t *dev, uint8_t ctrl, const uint8_t *buf, uint32_t sz)
+{
+	if(!sz || sz > 0xFFFF || !ssd1306_queue_room(1))
+		return 1;
+	ssd1306_queue_add(dev, ctrl, buf, sz);
+	ssd1306_queue_commit();
+	return 0;
+}
+
+/*
+ * queue command bytes
+ */
+uint8_t ssd1306_queue_cmds(i2c_device_t *dev, const uint8_t *cmds, uint32_t sz)
+{
+	return ssd1306_queue_xfer(dev, 0x00, cmds, sz);
+}
+
+/*
+ * queue data bytes
+ */
+uint8_t ssd1306_queue_data(i2c_device_t *dev, const uint8_t *data, uint32_t sz)
+{
+	return ssd1306_queue_xfer(dev, 0x40, data, sz);
+}
+
+#if !SSD1306_ROTATE_90
+/*
+ * queue full-width pages the way ssd1306_send_pages() sends them, the
+ * address windows are kept in the descriptors
+ */
+uint8_t ssd1306_queue_pages(i2c_device_t *dev, const uint8_t *data, uint32_t page, uint32_t pages)
+{
+	ssd1306_qdesc_t *d;
+	uint32_t rp, n;
+
+	if(!pages || page + pages > SSD1306_PAGES)
+		return 1;
+	rp = SSD1306_RAM_PAGE(page);
+	if(!ssd1306_queue_room(rp + pages > SSD1306_RAM_PAGES ? 4 : 2))
+		return 1;
+
+	while(pages)
+	{
+		rp = SSD1306_RAM_PAGE(page);
+		n = SSD1306_RAM_PAGES - rp;
+		if(n > pages) n = pages;
+
+		d = ssd1306_queue_add(dev, 0x00, NULL, 6);
+		memcpy(d->cmd, (uint8_t[]){
+			SSD1306_COLUMNADDR, SSD1306_OFFSET, SSD1306_OFFSET+SSD1306_W-1,
+			SSD1306_PAGEADDR, rp, rp+n-1}, 6);
+		ssd1306_queue_add(dev, 0x40, data, SSD1306_W * n);
+		data += SSD1306_W * n;
+		page += n;
+		pages -= n;
+	}
+	ssd1306_queue_commit();
+	return 0;
+}
+
+#if SSD1306_FRAMEBUFFER
+/*
+ * queue the whole frame buffer
+ */
+uint8_t ssd1306_queue_refresh(i2c_device_t *dev)
+{
+	if(ssd1306_queue_pages(dev, DISP_BUF, 0, SSD1306_PAGES))
+		return 1;
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_clear();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+	return 0;
+}
+#endif
+#endif
+
+/*
+ * free descriptors
+ */
+uint32_t ssd1306_queue_free(void)
+{
+	return SSD1306_QUEUE_LEN - (ssd1306_q_head - ssd1306_q_tail);
+}
+
+/*
+ * poll for the queue to drain
+ */
+uint8_t ssd1306_queue_busy(void)
+{
+	return ssd1306_q_busy;
+}
+
+/*
+ * block until the queue is empty, report and clear failures
+ */
+uint8_t ssd1306_queue_wait(void)
+{
+	uint8_t err;
+
+	while(ssd1306_q_busy);
+	err = ssd1306_q_err;
+	ssd1306_q_err = 0;
+	return err;
+}
+#endif
+
+/*
+ * send the start line, callers keep RAM and buffer bookkeeping in step
+ */
+static uint8_t ssd1306_send_start_line(i2c_device_t *dev, uint32_t line)
+{
+	uint8_t err;
+
+	line &= 8*SSD1306_RAM_PAGES - 1;
+#ifdef SH1107
+	err = ssd1306_cmds(dev, (uint8_t[]){SH1107_SETSTARTLINE, line}, 2);
+#else
+	err = ssd1306_cmd(dev, SSD1306_SETSTARTLINE | line);
+#endif
+	if(!err)
+		DISP_START_LINE = line;
+	return err;
+}
+
+/*
+ * set the RAM row shown on the top display line
+ */
+uint8_t ssd1306_set_start_line(i2c_device_t *dev, uint32_t line)
+{
+	uint32_t old = DISP_START_LINE/8;
+	uint8_t err = ssd1306_send_start_line(dev, line);
+
+	/* buffer pages now map to other RAM pages, which hold something else */
+	if(!err && (DISP_START_LINE/8 != old))
+	{
+#if SSD1306_DIRTY_TRACKING
+		ssd1306_dirty_all();
+#endif
+#if SSD1306_PAGE_HASH
+		DISP_HASH_VALID = 0;
+#endif
+	}
+	return err;
+}
+
+/*
+ * get the RAM row shown on the top display line
+ */
+uint32_t ssd1306_get_start_line(void)
+{
+	return DISP_START_LINE;
+}
+
+#if SSD1306_FRAMEBUFFER && !SSD1306_ROTATE_90
+/*
+ * scroll up (or down) by whole pages: move the start line and the buffer
+ * together so only the uncovered pages need sending
+ */
+uint8_t ssd1306_scroll_pages(i2c_device_t *dev, int32_t pages)
+{
+	uint32_t n = (pages < 0) ? -pages : pages;
+	uint32_t keep = (n < SSD1306_PAGES) ? SSD1306_PAGES - n : 0;
+	uint32_t p0;
+
+	if(ssd1306_send_start_line(dev, DISP_START_LINE + 8*pages))
+		return 1;
+	if(!n)
+		return 0;
+
+	if(!keep)
+	{
+		/* everything scrolled out */
+		ssd1306_setbuf(0);
+#if SSD1306_PAGE_HASH
+		DISP_HASH_VALID = 0;
+#endif
+		return 0;
+	}
+
+	/* move what stays visible, clear the rest */
+	p0 = (pages > 0) ? keep : 0;
+	if(pages > 0)
+		memmove(DISP_BUF, &DISP_BUF[SSD1306_W*n], SSD1306_W*keep);
+	else
+		memmove(&DISP_BUF[SSD1306_W*n], DISP_BUF, SSD1306_W*keep);
+	memset(&DISP_BUF[SSD1306_W*p0], 0, SSD1306_W*n);
+
+#if SSD1306_DIRTY_TRACKING
+	/* pending changes move along, the cleared pages must be sent */
+	if(pages > 0)
+	{
+		memmove(DISP_DIRTY_X0, &DISP_DIRTY_X0[n], keep);
+		memmove(DISP_DIRTY_X1, &DISP_DIRTY_X1[n], keep);
+	}
+	else
+	{
+		memmove(&DISP_DIRTY_X0[n], DISP_DIRTY_X0, keep);
+		memmove(&DISP_DIRTY_X1[n], DISP_DIRTY_X1, keep);
+	}
+	memset(&DISP_DIRTY_X0[p0], 0, n);
+	memset(&DISP_DIRTY_X1[p0], SSD1306_W-1, n);
+#endif
+
+#if SSD1306_PAGE_HASH
+	/* hashes stay with their RAM pages, the cleared pages are unknown */
+	if(pages > 0)
+	{
+		memmove(DISP_HASH, &DISP_HASH[n], 4*keep);
+		DISP_HASH_VALID >>= n;
+	}
+	else
+	{
+		memmove(&DISP_HASH[n], DISP_HASH, 4*keep);
+		DISP_HASH_VALID = (DISP_HASH_VALID << n) & ((1u<<SSD1306_PAGES)-1);
+	}
+#endif
+
+	return 0;
+}
+#endif
+
+#ifndef SH1107
+/*
+ * set up and start diagonal or horizontal scrolling of a page range,
+ * dy = 0xFF selects the horizontal only command
+ */
+static uint8_t ssd1306_scroll_setup(i2c_device_t *dev, uint8_t left, uint32_t p0, uint32_t p1, uint8_t interval, uint8_t dy)
+{
+	uint32_t rp0 = SSD1306_RAM_PAGE(p0), rp1 = SSD1306_RAM_PAGE(p1);
+
+	if((p0 > p1) || (p1 >= SSD1306_PANEL_PAGES) || (rp0 > rp1))
+		return 1;
+
+	if(dy == 0xFF)
+		return ssd1306_cmds(dev, (uint8_t[]){SSD1306_DEACTIVATE_SCROLL,
+			left ? SSD1306_LEFT_HORIZONTAL_SCROLL : SSD1306_RIGHT_HORIZONTAL_SCROLL,
+			0x00, rp0, interval & 7, rp1, 0x00, 0xFF, SSD1306_ACTIVATE_SCROLL}, 9);
+
+	return ssd1306_cmds(dev, (uint8_t[]){SSD1306_DEACTIVATE_SCROLL,
+		left ? SSD1306_VERTICAL_AND_LEFT_HORIZONTAL_SCROLL : SSD1306_VERTICAL_AND_RIGHT_HORIZONTAL_SCROLL,
+		0x00, rp0, interval & 7, rp1, dy & 0x3F, SSD1306_ACTIVATE_SCROLL}, 8);
+}
+
+/*
+ * continuous horizontal scroll
+ */
+uint8_t ssd1306_hscroll(i2c_device_t *dev, uint8_t left, uint32_t p0, uint32_t p1, uint8_t interval)
+{
+	return ssd1306_scroll_setup(dev, left, p0, p1, interval, 0xFF);
+}
+
+/*
+ * continuous diagonal scroll
+ */
+uint8_t ssd1306_vhscroll(i2c_device_t *dev, uint8_t left, uint32_t p0, uint32_t p1, uint8_t interval, uint8_t dy)
+{
+	return ssd1306_scroll_setup(dev, left, p0, p1, interval, dy & 0x3F);
+}
+
+/*
+ * rows moved by vertical scrolling
+ */
+uint8_t ssd1306_vscroll_area(i2c_device_t *dev, uint8_t top, uint8_t rows)
+{
+	return ssd1306_cmds(dev, (uint8_t[]){SSD1306_SET_VERTICAL_SCROLL_AREA, top, rows}, 3);
+}
+
+/*
+ * stop scrolling, RAM no longer matches what was sent
+ */
+uint8_t ssd1306_scroll_stop(i2c_device_t *dev)
+{
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_all();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+	return ssd1306_cmd(dev, SSD1306_DEACTIVATE_SCROLL);
+}
+#endif
+
+/*
+ * plot a pixel in the buffer
+ */
+void ssd1306_drawPixel(uint32_t x, uint32_t y, int color)
+{
+	uint32_t addr;
+	
+	/* clip */
+	y -= TARGET_Y0;
+	if(x >= (uint32_t)TARGET_W)
+		return;
+	if(y >= TARGET_H)
+		return;
+	
+	/* compute buffer address */
+	addr = x + TARGET_W*(y/8);
+	SSD1306_DIRTY_SPAN(y/8, x, x);
+	
+	/* set/clear bit in buffer */
+	if(color)
+		TARGET_BUF[addr] |= (1<<(y&7));
+	else
+		TARGET_BUF[addr] &= ~(1<<(y&7));
+}
+
+/*
+ * plot a pixel in the buffer
+ */
+void ssd1306_xorPixel(uint32_t x, uint32_t y)
+{
+	uint32_t addr;
+	
+	/* clip */
+	y -= TARGET_Y0;
+	if(x >= (uint32_t)TARGET_W)
+		return;
+	if(y >= TARGET_H)
+		return;
+	
+	/* compute buffer address */
+	addr = x + TARGET_W*(y/8);
+	SSD1306_DIRTY_SPAN(y/8, x, x);
+	
+	TARGET_BUF[addr] ^= (1<<(y&7));
+}
+
+/*
+ * per blend mode: buffer bits cleared, set and toggled for a 0 and a 1
+ * input pixel, so the mode is resolved once per row instead of per pixel
+ */
+static const uint8_t ssd1306_image_ops[7][2][3] =
+{
+	//  pixel 0      pixel 1
+	// clr set tog  clr set tog
+	{ {1, 0, 0}, {1, 1, 0} }, // imagemode_copy
+	{ {1, 1, 0}, {1, 0, 0} }, // imagemode_invert
+	{ {1, 0, 0}, {0, 0, 0} }, // imagemode_and
+	{ {0, 0, 0}, {0, 1, 0} }, // imagemode_or
+	{ {0, 1, 0}, {0, 0, 0} }, // imagemode_ornot
+	{ {0, 0, 0}, {1, 0, 0} }, // imagemode_andnot
+	{ {0, 0, 0}, {0, 0, 1} }, // imagemode_xor
+};
+
+/*
+ * draw a an image from an array, directly into to the display buffer
+ * the color modes allow for overwriting and even layering (sprites!)
+ */
+void ssd1306_drawImage(uint32_t x, uint32_t y, const unsigned char* input, uint32_t width, uint32_t height, uint32_t color_mode) {
+	uint32_t x_absolute;
+	int32_t y_absolute;
+	uint32_t pixel;
+	uint32_t bytes_to_draw = width / 8;
+	uint32_t buffer_addr;
+	const uint8_t (*ops)[3];
+
+	if (color_mode > imagemode_xor) {
+		return;
+	}
+	ops = ssd1306_image_ops[color_mode];
+
+	// columns actually touched are x+8 .. x+8*bytes_to_draw+7
+	SSD1306_DIRTY_RECT(x + 8, y, 8 * bytes_to_draw, height);
+
+	for (uint32_t line = 0; line < height; line++) {
+		y_absolute = y + line - TARGET_Y0;
+		if (y_absolute < 0) {
+			continue;
+		}
+		if (y_absolute >= (int32_t)TARGET_H) {
+			break;
+		}
+
+		// SSD1306 is in vertical mode, yet we want to draw horizontally, which necessitates assembling the output bytes from the input data
+		// bitmask for current pixel in vertical (output) byte
+		uint8_t v_mask = 1 << (y_absolute & 7);
+
+		// clear, set and toggle masks for a 0 and a 1 input pixel
+		uint8_t clr[2] = { ops[0][0] ? v_mask : 0, ops[1][0] ? v_mask : 0 };
+		uint8_t set[2] = { ops[0][1] ? v_mask : 0, ops[1][1] ? v_mask : 0 };
+		uint8_t tog[2] = { ops[0][2] ? v_mask : 0, ops[1][2] ? v_mask : 0 };
+
+		for (uint32_t byte = 0; byte < bytes_to_draw; byte++) {
+			uint32_t input_byte = input[byte + line * bytes_to_draw];
+
+			for (pixel = 0; pixel < 8; pixel++) {
+				x_absolute = x + 8 * (bytes_to_draw - byte) + pixel;
+				if (x_absolute >= (uint32_t)TARGET_W) {
+					break;
+				}
+				// looking at the horizontal display, we're drawing bytes bottom to top, not left to right, hence y / 8
+				buffer_addr = x_absolute + TARGET_W * (y_absolute / 8);
+				// state of current pixel
+				uint32_t input_pixel = (input_byte >> pixel) & 1;
+
+				TARGET_BUF[buffer_addr] = ((TARGET_BUF[buffer_addr] & ~clr[input_pixel]) | set[input_pixel]) ^ tog[input_pixel];
+			}
+			#if SSD1306_LOG_IMAGE == 1
+			printf("%02x ", input_byte);
+			#endif
+		}
+		#if SSD1306_LOG_IMAGE == 1
+		printf("\n\r");
+		#endif
+	}
+}
+
+// one blend loop, s = shifted source byte, m = bits of dst it covers
+#define SSD1306_BLEND_LOOP(op) \
+	for(i=0;i<n;i++) { uint8_t s = (src[i] << shift) >> rs; op; }
+
+/*
+ * blend one row of page-format source bytes into one buffer page;
+ * rs = 0 places the low part of the shifted byte, rs = 8 the spill
+ * into the next page. Each mode gets its own loop.
+ */
+static void ssd1306_blend_row(uint8_t *dst, const uint8_t *src, uint32_t n,
+	uint32_t shift, uint32_t rs, uint8_t valid, uint32_t mode)
+{
+	uint8_t m = (valid << shift) >> rs;
+	uint32_t i;
+
+	switch(mode)
+	{
+		case imagemode_copy:
+			if(m == 0xFF)
+				SSD1306_BLEND_LOOP(dst[i] = s)
+			else
+				SSD1306_BLEND_LOOP(dst[i] = (dst[i] & ~m) | (s & m))
+			break;
+		case imagemode_invert:
+			SSD1306_BLEND_LOOP(dst[i] = (dst[i] & ~m) | (~s & m))
+			break;
+		case imagemode_and:
+			SSD1306_BLEND_LOOP(dst[i] &= s | ~m)
+			break;
+		case imagemode_or:
+			SSD1306_BLEND_LOOP(dst[i] |= s & m)
+			break;
+		case imagemode_ornot:
+			SSD1306_BLEND_LOOP(dst[i] |= ~s & m)
+			break;
+		case imagemode_andnot:
+			SSD1306_BLEND_LOOP(dst[i] &= ~(s & m))
+			break;
+		case imagemode_xor:
+			SSD1306_BLEND_LOOP(dst[i] ^= s & m)
+			break;
+	}
+}
+
+/*
+ * clip a page-format image: visible columns skip..skip+n-1 go to x,
+ * marks the visible part modified
+ */
+static uint8_t ssd1306_image_clip(int32_t *x, int32_t *y, uint32_t width, uint32_t height, uint32_t *skip, uint32_t *n)
+{
+	*y -= TARGET_Y0;
+	*skip = 0;
+	if((*x >= TARGET_W) || (*y >= (int32_t)TARGET_H) || !width || !height) return 0;
+	if((*y < 0) && ((int32_t)height <= -*y)) return 0;
+	if(*x < 0)
+	{
+		if((uint32_t)-*x >= width) return 0;
+		*skip = -*x;
+		*x = 0;
+	}
+	*n = width - *skip;
+	if(*n > (uint32_t)(TARGET_W - *x)) *n = TARGET_W - *x;
+
+	SSD1306_DIRTY_RECT(*x, *y < 0 ? 0 : *y, *n, *y < 0 ? (int32_t)height + *y : (int32_t)height);
+	return 1;
+}
+
+/*
+ * blend n bytes of one image page into target page `page` and the
+ * page below it, either may be off the target
+ */
+static void ssd1306_blend_page(uint32_t x, int32_t page, const uint8_t *src, uint32_t n,
+	uint32_t shift, uint8_t valid, uint32_t mode)
+{
+	/* low part into this page */
+	if((page >= 0) && (page < (int32_t)TARGET_PAGES))
+		ssd1306_blend_row(&TARGET_BUF[x + TARGET_W*page], src, n, shift, 0, valid, mode);
+
+	/* spill into the next page */
+	page++;
+	if(shift && (page >= 0) && (page < (int32_t)TARGET_PAGES))
+		ssd1306_blend_row(&TARGET_BUF[x + TARGET_W*page], src, n, shift, 8, valid, mode);
+}
+
+/*
+ * draw a page-format image: byte copies when y is page-aligned,
+ * two shifted blends per source byte otherwise
+ */
+void ssd1306_drawPageImage(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	uint32_t shift, pages = (height + 7) / 8, sp, n, skip;
+	int32_t page;
+
+	if(!ssd1306_image_clip(&x, &y, width, height, &skip, &n))
+		return;
+
+	shift = y & 7;
+	page = y >> 3;  // floor, also for negative y
+	for(sp=0;sp<pages;sp++, page++)
+	{
+		uint8_t valid = (sp == pages-1 && (height & 7)) ? 0xFF >> (8 - (height & 7)) : 0xFF;
+		ssd1306_blend_page(x, page, &input[sp*width + skip], n, shift, valid, color_mode);
+	}
+}
+
+/*
+ * RLE decoder state: bytes left in the current literal or repeat run
+ */
+typedef struct {
+	const uint8_t *src;
+	uint32_t n;
+	uint8_t rep;
+} ssd1306_rle_t;
+
+/*
+ * decode the next sz bytes: control 0x00-0x7F = 1-128 literal bytes
+ * follow, 0x80-0xFF = the next byte repeated 2-129 times
+ */
+static void ssd1306_rle_read(ssd1306_rle_t *rle, uint8_t *dst, uint32_t sz)
+{
+	uint32_t k;
+
+	while(sz)
+	{
+		if(!rle->n)
+		{
+			uint8_t c = *rle->src++;
+			rle->rep = c & 0x80;
+			rle->n = rle->rep ? (c & 0x7F) + 2 : c + 1;
+		}
+		k = (rle->n < sz) ? rle->n : sz;
+		if(rle->rep)
+			memset(dst, *rle->src, k);
+		else
+		{
+			memcpy(dst, rle->src, k);
+			rle->src += k;
+		}
+		rle->n -= k;
+		if(rle->rep && !rle->n)
+			rle->src++;
+		dst += k;
+		sz -= k;
+	}
+}
+
+/*
+ * draw an RLE compressed page-format image, decoded in packet sized chunks
+ */
+void ssd1306_drawRleImage(int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	uint8_t tmp[SSD1306_PSZ];
+	ssd1306_rle_t rle = { input, 0, 0 };
+	uint32_t shift, pages = (height + 7) / 8, sp, n, skip, c, k, lo, hi;
+	int32_t page;
+
+	if(!ssd1306_image_clip(&x, &y, width, height, &skip, &n))
+		return;
+
+	shift = y & 7;
+	page = y >> 3;
+	for(sp=0;(sp<pages) && (page<(int32_t)TARGET_PAGES);sp++, page++)
+	{
+		uint8_t valid = (sp == pages-1 && (height & 7)) ? 0xFF >> (8 - (height & 7)) : 0xFF;
+
+		for(c=0;c<width;c+=k)
+		{
+			k = (width - c > SSD1306_PSZ) ? SSD1306_PSZ : width - c;
+			ssd1306_rle_read(&rle, tmp, k);
+
+			/* columns of this chunk that are visible */
+			lo = (c > skip) ? c : skip;
+			hi = (c+k < skip+n) ? c+k : skip+n;
+			if((lo < hi) && (page >= -1))
+				ssd1306_blend_page(x + lo-skip, page, &tmp[lo-c], hi-lo, shift, valid, color_mode);
+		}
+	}
+}
+
+#if !SSD1306_ROTATE_90
+/*
+ * decode a full-screen RLE image straight to controller RAM, packet by
+ * packet, leaving the frame buffer alone
+ */
+uint8_t ssd1306_streamRleImage(i2c_device_t *dev, const uint8_t *input)
+{
+	uint8_t tmp[SSD1306_PSZ];
+	ssd1306_rle_t rle = { input, 0, 0 };
+	uint32_t page = 0, rp, n, sz, k;
+	uint8_t err = 0, werr;
+
+	while(page < SSD1306_PAGES)
+	{
+		rp = SSD1306_RAM_PAGE(page);
+		n = SSD1306_RAM_PAGES - rp;
+		if(n > SSD1306_PAGES - page) n = SSD1306_PAGES - page;
+
+		/* after a failed window only decode, the data would land at the old cursor */
+		werr = ssd1306_window(dev, 0, SSD1306_W-1, rp, rp+n-1);
+		err |= werr;
+		for(sz=SSD1306_W*n;sz;sz-=k)
+		{
+			k = (sz > SSD1306_PSZ) ? SSD1306_PSZ : sz;
+			ssd1306_rle_read(&rle, tmp, k);
+			if(!werr)
+				err |= ssd1306_write(dev, 0x40, tmp, k);
+		}
+		page += n;
+	}
+#if SSD1306_PAGE_HASH
+	/* RAM no longer holds what the hashes describe */
+	DISP_HASH_VALID = 0;
+#endif
+	return err;
+}
+#endif
+
+/*
+ * clip a rectangle to the panel (or strip) and make it target-relative,
+ * 0 if nothing is left
+ */
+static inline uint8_t ssd1306_clip(int32_t *x, int32_t *y, int32_t *w, int32_t *h)
+{
+	*y -= TARGET_Y0;
+	if(*x < 0) { *w += *x; *x = 0; }
+	if(*y < 0) { *h += *y; *y = 0; }
+	if((*w <= 0) || (*h <= 0) || (*x >= TARGET_W) || (*y >= (int32_t)TARGET_H))
+		return 0;
+	if(*w > TARGET_W - *x) *w = TARGET_W - *x;
+	if(*h > (int32_t)TARGET_H - *y) *h = TARGET_H - *y;
+	return 1;
+}
+
+// span kernel operations
+#define SSD1306_SPAN_CLR 0
+#define SSD1306_SPAN_SET 1
+#define SSD1306_SPAN_XOR 2
+
+/*
+ * fill, clear or invert a clipped rectangle page by page: masked top and
+ * bottom pages, whole bytes for the full pages in between
+ */
+static void ssd1306_span_fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t op)
+{
+	uint32_t page = y/8, last = (y+h-1)/8, i;
+	uint8_t mask = 0xFF << (y&7);
+	uint8_t *dst = &TARGET_BUF[x + TARGET_W*page];
+
+	for(;page<=last;page++)
+	{
+		SSD1306_DIRTY_SPAN(page, x, x+w-1);
+		if(page == last)
+			mask &= 0xFF >> (7 - ((y+h-1)&7));
+
+		if(op == SSD1306_SPAN_XOR)
+			for(i=0;i<w;i++) dst[i] ^= mask;
+		else if(mask == 0xFF)
+			memset(dst, op ? 0xFF : 0x00, w);
+		else if(op)
+			for(i=0;i<w;i++) dst[i] |= mask;
+		else
+			for(i=0;i<w;i++) dst[i] &= ~mask;
+
+		mask = 0xFF;
+		dst += TARGET_W;
+	}
+}
+
+/*
+ *  fast vert line
+ */
+void ssd1306_drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color)
+{
+	int32_t w = 1;
+
+	if(ssd1306_clip(&x, &y, &w, &h))
+		ssd1306_span_fill(x, y, 1, h, color ? SSD1306_SPAN_SET : SSD1306_SPAN_CLR);
+}
+
+/*
+ *  fast horiz line
+ */
+void ssd1306_drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color)
+{
+	int32_t h = 1;
+
+	if(ssd1306_clip(&x, &y, &w, &h))
+		ssd1306_span_fill(x, y, w, 1, color ? SSD1306_SPAN_SET : SSD1306_SPAN_CLR);
+}
+
+/*
+ * abs() helper function for line drawing
+ */
+int gfx_abs(int x)
+{
+	return (x<0) ? -x : x;
+}
+
+/*
+ * swap() helper function for line drawing
+ */
+void gfx_swap(int *z0, int *z1)
+{
+	int temp = *z0;
+	*z0 = *z1;
+	*z1 = temp;
+}
+
+/*
+ * first Bresenham step after which the minor axis has moved m >= 1 times,
+ * steps taken after k steps being (k*dy + dx-1 - err0)/dx
+ */
+static int32_t ssd1306_line_step(int32_t m, int32_t dx, int32_t dy, int32_t err0)
+{
+	return ((int64_t)(m-1)*dx + err0)/dy + 1;
+}
+
+/*
+ * Bresenham line draw routine swiped from Wikipedia, clipped once up front
+ * by solving for the first and last visible step; straight lines go to the
+ * span kernels
+ */
+void ssd1306_drawLine(int x0, int y0, int x1, int y1, uint32_t color)
+{
+	int32_t steep, umax, vmax, lo, hi, k0, k1, n;
+	int32_t deltax, deltay, error, err0, ystep, x, y;
+	uint8_t *dst, mask;
+
+	if(y0 == y1)
+	{
+		if(x0 > x1) gfx_swap(&x0, &x1);
+		ssd1306_drawFastHLine(x0, y0, x1-x0+1, color);
+		return;
+	}
+	if(x0 == x1)
+	{
+		if(y0 > y1) gfx_swap(&y0, &y1);
+		ssd1306_drawFastVLine(x0, y0, y1-y0+1, color);
+		return;
+	}
+	y0 -= TARGET_Y0;
+	y1 -= TARGET_Y0;
+
+	/* flip sense 45deg to keep error calc in range */
+	steep = (gfx_abs(y1 - y0) > gfx_abs(x1 - x0));
+
+	if(steep)
+	{
+		gfx_swap(&x0, &y0);
+		gfx_swap(&x1, &y1);
+	}
+
+	/* run low->high */
+	if(x0 > x1)
+	{
+		gfx_swap(&x0, &x1);
+		gfx_swap(&y0, &y1);
+	}
+
+	/* set up loop initial conditions */
+	deltax = x1 - x0;
+	deltay = gfx_abs(y1 - y0);
+	err0 = deltax/2;
+	if(y0 < y1)
+		ystep = 1;
+	else
+		ystep = -1;
+	umax = steep ? (int32_t)TARGET_H-1 : TARGET_W-1;
+	vmax = steep ? TARGET_W-1 : (int32_t)TARGET_H-1;
+
+	/* clip the major axis */
+	if((x1 < 0) || (x0 > umax))
+		return;
+	k0 = (x0 < 0) ? -x0 : 0;
+	k1 = ((x1 > umax) ? umax : x1) - x0;
+
+	/* clip the minor axis: minor steps needed to enter and to leave */
+	lo = (ystep > 0) ? -y0 : y0 - vmax;
+	hi = (ystep > 0) ? vmax - y0 : y0;
+	if((hi < 0) || (lo > deltay))
+		return;
+	if(lo > 0)
+	{
+		n = ssd1306_line_step(lo, deltax, deltay, err0);
+		if(n > k0) k0 = n;
+	}
+	if(hi < deltay)
+	{
+		n = ssd1306_line_step(hi+1, deltax, deltay, err0) - 1;
+		if(n < k1) k1 = n;
+	}
+	if(k0 > k1)
+		return;
+
+	/* state at the first visible step */
+	n = k0 ? ((int64_t)k0*deltay + deltax-1 - err0)/deltax : 0;
+	error = err0 - (int64_t)k0*deltay + (int64_t)n*deltax;
+	x = x0 + k0;
+	y = y0 + ystep*n;
+	x1 = x0 + k1;
+
+	if(!steep)
+	{
+		/* one bit per column, follow it across pages */
+		int32_t xs = x;
+		dst = &TARGET_BUF[x + TARGET_W*(y/8)];
+		mask = 1 << (y&7);
+
+		for(;x<=x1;x++,dst++)
+		{
+			if(color)
+				*dst |= mask;
+			else
+				*dst &= ~mask;
+
+			error = error - deltay;
+			if(error >= 0)
+				continue;
+			y = y + ystep;
+			error = error + deltax;
+			mask = (ystep > 0) ? mask << 1 : mask >> 1;
+			if(mask)
+				continue;
+
+			/* crossed into the next page */
+			SSD1306_DIRTY_SPAN((y-ystep)/8, xs, x);
+			xs = x+1;
+			if(ystep > 0)
+			{
+				mask = 0x01;
+				dst += TARGET_W;
+			}
+			else
+			{
+				mask = 0x80;
+				dst -= TARGET_W;
+			}
+		}
+		if(xs < x)
+			SSD1306_DIRTY_SPAN(y/8, xs, x-1);
+	}
+	else
+	{
+		/* x is the row here: collect the bits of a column byte, one write each */
+		dst = &TARGET_BUF[y + TARGET_W*(x/8)];
+		mask = 0;
+
+		for(;x<=x1;x++)
+		{
+			mask |= 1 << (x&7);
+
+			error = error - deltay;
+			if((error >= 0) && ((x&7) != 7) && (x < x1))
+				continue;
+
+			if(color)
+				*dst |= mask;
+			else
+				*dst &= ~mask;
+			SSD1306_DIRTY_SPAN(x/8, y, y);
+			mask = 0;
+
+			if(error < 0)
+			{
+				y = y + ystep;
+				error = error + deltax;
+				dst += ystep;
+			}
+			if((x&7) == 7)
+				dst += TARGET_W;
+		}
+	}
+}
+
+/*
+ *  draws a circle
+ */
+void ssd1306_drawCircle(int x, int y, int radius, int color)
+{
+    /* Bresenham algorithm */
+    int x_pos = -radius;
+    int y_pos = 0;
+    int err = 2 - 2 * radius;
+    int e2;
+
+    do {
+        ssd1306_drawPixel(x - x_pos, y + y_pos, color);
+        ssd1306_drawPixel(x + x_pos, y + y_pos, color);
+        ssd1306_drawPixel(x + x_pos, y - y_pos, color);
+        ssd1306_drawPixel(x - x_pos, y - y_pos, color);
+        e2 = err;
+        if (e2 <= y_pos) {
+            err += ++y_pos * 2 + 1;
+            if(-x_pos == y_pos && e2 <= x_pos) {
+              e2 = 0;
+            }
+        }
+        if (e2 > x_pos) {
+            err += ++x_pos * 2 + 1;
+        }
+    } while (x_pos <= 0);
+}
+
+/*
+ * clip and fill a rectangle with a span kernel operation
+ */
+static void ssd1306_fill_op(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t op)
+{
+	if(ssd1306_clip(&x, &y, &w, &h))
+		ssd1306_span_fill(x, y, w, h, op);
+}
+
+/*
+ * fill columns x0..x1 of the rows d0..d1 above yt and below yb, the
+ * centre row only once when yt == yb
+ */
+static void ssd1306_round_rows(int32_t x0, int32_t x1, int32_t yt, int32_t yb, int32_t d0, int32_t d1, uint32_t op)
+{
+	ssd1306_fill_op(x0, yt-d1, x1-x0+1, d1-d0+1, op);
+	if((yt == yb) && !d0)
+		d0 = 1;
+	ssd1306_fill_op(x0, yb+d0, x1-x0+1, d1-d0+1, op);
+}
+
+/*
+ * rounded shape with corner centres xl/xr and yt/yb: Bresenham quarter
+ * circle, filled as merged rows (each row once) or drawn as outline
+ */
+static void ssd1306_round(int32_t xl, int32_t xr, int32_t yt, int32_t yb, int32_t r, uint32_t color, uint8_t fill)
+{
+	int32_t x_pos = -r, y_pos = 0, err = 2 - 2 * r, e2;
+	int32_t run = 0, last = -1, hw = r;
+	uint32_t op = color ? SSD1306_SPAN_SET : SSD1306_SPAN_CLR;
+
+	if(r < 0)
+		return;
+
+	if(fill)
+	{
+		if(yb > yt+1)
+			ssd1306_fill_op(xl-r, yt+1, xr-xl+1+2*r, yb-yt-1, op);
+	}
+	else
+	{
+		ssd1306_drawFastHLine(xl, yt-r, xr-xl+1, color);
+		ssd1306_drawFastHLine(xl, yb+r, xr-xl+1, color);
+		ssd1306_drawFastVLine(xl-r, yt, yb-yt+1, color);
+		ssd1306_drawFastVLine(xr+r, yt, yb-yt+1, color);
+	}
+
+	do {
+		if(!fill)
+		{
+			ssd1306_drawPixel(xr - x_pos, yb + y_pos, color);
+			ssd1306_drawPixel(xl + x_pos, yb + y_pos, color);
+			ssd1306_drawPixel(xl + x_pos, yt - y_pos, color);
+			ssd1306_drawPixel(xr - x_pos, yt - y_pos, color);
+		}
+		else if(y_pos != last)
+		{
+			/* first visit of a row is its widest, merge rows of equal width */
+			if(-x_pos != hw)
+			{
+				ssd1306_round_rows(xl-hw, xr+hw, yt, yb, run, last, op);
+				run = y_pos;
+				hw = -x_pos;
+			}
+			last = y_pos;
+		}
+		e2 = err;
+		if (e2 <= y_pos) {
+			err += ++y_pos * 2 + 1;
+			if(-x_pos == y_pos && e2 <= x_pos) {
+				e2 = 0;
+			}
+		}
+		if(e2 > x_pos) {
+			err += ++x_pos * 2 + 1;
+		}
+	} while(x_pos <= 0);
+
+	if(fill)
+		ssd1306_round_rows(xl-hw, xr+hw, yt, yb, run, last, op);
+}
+
+/*
+ *  draws a filled circle
+ */
+void ssd1306_fillCircle(int x, int y, int radius, int color)
+{
+	ssd1306_round(x, x, y, y, radius, color, 1);
+}
+
+/*
+ * rounded rectangle, radius limited to fit
+ */
+static void ssd1306_round_rect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color, uint8_t fill)
+{
+	if(!w || !h)
+		return;
+	if(r > (w-1)/2) r = (w-1)/2;
+	if(r > (h-1)/2) r = (h-1)/2;
+	ssd1306_round(x+r, x+w-1-r, y+r, y+h-1-r, r, color, fill);
+}
+
+/*
+ *  draw a rounded rectangle
+ */
+void ssd1306_drawRoundRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color)
+{
+	ssd1306_round_rect(x, y, w, h, r, color, 0);
+}
+
+/*
+ *  fill a rounded rectangle
+ */
+void ssd1306_fillRoundRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color)
+{
+	ssd1306_round_rect(x, y, w, h, r, color, 1);
+}
+
+/*
+ *  draw a rectangle
+ */
+void ssd1306_drawRect(int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color)
+{
+	ssd1306_drawFastVLine(x, y, h, color);
+	ssd1306_drawFastVLine(x+w-1, y, h, color);
+	ssd1306_drawFastHLine(x, y, w, color);
+	ssd1306_drawFastHLine(x, y+h-1, w, color);
+}
+
+/*
+ * fill a rectangle
+ */
+void ssd1306_fillRect(uint32_t x, uint32_t y, uint8_t w, uint32_t h, uint32_t color)
+{
+	int32_t cx = x, cy = y, cw = w, ch = h;
+
+	if(ssd1306_clip(&cx, &cy, &cw, &ch))
+		ssd1306_span_fill(cx, cy, cw, ch, color ? SSD1306_SPAN_SET : SSD1306_SPAN_CLR);
+}
+
+/*
+ * fill a rectangle of the buffer with a color
+ */
+void ssd1306_setbuf_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t color)
+{
+	if(ssd1306_clip(&x, &y, &w, &h))
+		ssd1306_span_fill(x, y, w, h, color ? SSD1306_SPAN_SET : SSD1306_SPAN_CLR);
+}
+
+/*
+ * invert a rectangle in the buffer
+ */
+void ssd1306_xorrect(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	if(ssd1306_clip(&x, &y, &w, &h))
+		ssd1306_span_fill(x, y, w, h, SSD1306_SPAN_XOR);
+}
+
+#ifdef SSD1306_FONT_CM
+/*
+ * Draw character to the display buffer from the column-major font:
+ * one byte store per column when y is page-aligned, two masked
+ * shifted stores per column otherwise
+ */
+void ssd1306_drawchar(uint8_t x, uint8_t y, uint8_t chr, uint8_t color)
+{
+	const uint8_t *glyph = &fontdata_cm[chr<<3];
+	int32_t ty = y - TARGET_Y0, page = ty >> 3;
+	uint32_t i, n, shift = ty & 7;
+	uint8_t inv = color ? 0x00 : 0xFF, keep;
+	uint8_t *dst;
+
+	// clipping
+	if((x >= TARGET_W) || (ty >= (int32_t)TARGET_H) || (ty <= -8)) return;
+	n = (TARGET_W - x < 8) ? TARGET_W - x : 8;
+
+	dst = &TARGET_BUF[x + TARGET_W*page];
+	if(!shift)
+	{
+		SSD1306_DIRTY_SPAN(page, x, x+n-1);
+		for(i=0;i<n;i++)
+			dst[i] = glyph[i] ^ inv;
+		return;
+	}
+
+	/* upper part of the glyph goes to the high bits of this page */
+	keep = 0xFF >> (8-shift);
+	if(page >= 0)
+	{
+		SSD1306_DIRTY_SPAN(page, x, x+n-1);
+		for(i=0;i<n;i++)
+			dst[i] = (dst[i] & keep) | ((glyph[i] ^ inv) << shift);
+	}
+
+	/* the rest to the low bits of the next page, if any */
+	if(++page >= (int32_t)TARGET_PAGES) return;
+	dst += TARGET_W;
+	SSD1306_DIRTY_SPAN(page, x, x+n-1);
+	for(i=0;i<n;i++)
+		dst[i] = (dst[i] & ~keep) | ((glyph[i] ^ inv) >> (8-shift));
+}
+#else
+/*
+ * Draw character to the display buffer
+ */
+void ssd1306_drawchar(uint8_t x, uint8_t y, uint8_t chr, uint8_t color)
+{
+	uint16_t i, j, col;
 	uint8_t d;
 	
 	for(i=0;i<8;i++)
 	{
-		d = fontdata[(chr<<3)+i];
-		for(j=0;j<8;j++)
+		d = fontdata[(chr<<3)+i];
+		for(j=0;j<8;j++)
+		{
+			if(d&0x80)
+				col = color;
+			else
+				col = (~color)&1;
+			
+			ssd1306_drawPixel(x+j, y+i, col);
+			
+			// next bit
+			d <<= 1;
+		}
+	}
+}
+#endif
+
+/*
+ * draw a string to the display
+ */
+void ssd1306_drawstr(uint8_t x, uint8_t y, char *str, uint8_t color)
+{
+	uint8_t c;
+	
+	while((c=*str++))
+	{
+		ssd1306_drawchar(x, y, c, color);
+		x += 8;
+		if(x>TARGET_W-8)
+			break;
+	}
+}
+
+// nibble -> byte with every bit doubled, e.g. 0b0101 -> 0b00110011
+static const uint8_t ssd1306_bit2x[16] =
+{
+	0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+	0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF,
+};
+
+#ifdef SSD1306_FONT_CM
+// the column-major font is already one page-format image per glyph
+const ssd1306_font_t ssd1306_font8x8 = { fontdata_cm, NULL, NULL, 0, 255, 8, 8, 0 };
+#endif
+
+/*
+ * glyph width in a font descriptor, 0 if the font does not have it
+ */
+static uint32_t ssd1306_glyph_width(const ssd1306_font_t *font, uint8_t chr)
+{
+	if((chr < font->first) || (chr > font->last))
+		return 0;
+	return font->width ? font->width[chr - font->first] : font->fixed;
+}
+
+/*
+ * Draw character from a font descriptor: the glyph is a page-format
+ * image, the spacing columns are cleared to the background
+ */
+uint32_t ssd1306_drawchar_font(int32_t x, int32_t y, uint8_t chr, uint8_t color, const ssd1306_font_t *font)
+{
+	uint32_t w = ssd1306_glyph_width(font, chr), idx;
+	const uint8_t *glyph;
+
+	if(!w)
+		return 0;
+
+	idx = chr - font->first;
+	if(font->offset)
+		glyph = &font->bitmap[font->offset[idx]];
+	else
+		glyph = &font->bitmap[idx * w * ((font->height + 7) / 8)];
+
+	ssd1306_drawPageImage(x, y, glyph, w, font->height, color ? imagemode_copy : imagemode_invert);
+	if(font->spacing)
+		ssd1306_setbuf_rect(x + w, y, font->spacing, font->height, !color);
+	return w + font->spacing;
+}
+
+/*
+ * draw a string from a font descriptor, clipped at the right edge
+ */
+uint32_t ssd1306_drawstr_font(int32_t x, int32_t y, const char *str, uint8_t color, const ssd1306_font_t *font)
+{
+	int32_t cx = x;
+
+	while(*str && (cx < TARGET_W))
+		cx += ssd1306_drawchar_font(cx, y, *str++, color, font);
+	return cx - x;
+}
+
+/*
+ * width of a string in a font descriptor
+ */
+uint32_t ssd1306_strwidth_font(const char *str, const ssd1306_font_t *font)
+{
+	uint32_t w = 0, gw;
+
+	while(*str)
+		if((gw = ssd1306_glyph_width(font, *str++)))
+			w += gw + font->spacing;
+	return w;
+}
+
+/*
+ * fetch one glyph column as a vertical byte, bit 0 = top row
+ */
+static inline uint8_t ssd1306_glyph_col(uint8_t chr, uint32_t j)
+{
+#ifdef SSD1306_FONT_CM
+	return fontdata_cm[(chr<<3)+j];
+#else
+	uint32_t i;
+	uint8_t c = 0;
+
+	for(i=0;i<8;i++)
+		c |= ((fontdata[(chr<<3)+i] >> (7-j)) & 1) << i;
+	return c;
+#endif
+}
+
+/*
+ * Draw character to the display buffer, scaled to size
+ * each glyph column is expanded into font_scale vertical bytes with the
+ * bit doubling table and then stored into font_scale buffer columns
+ */
+void ssd1306_drawchar_sz(uint8_t x, uint8_t y, uint8_t chr, uint8_t color, font_size_t font_size)
+{
+    uint32_t font_scale = (uint32_t)font_size;
+    int32_t ty = y - TARGET_Y0, page0 = ty >> 3;
+    uint32_t shift = ty&7, i, j, k, n;
+    uint8_t col[8 + 1];   // expanded column, one spare byte for the shift
+    uint8_t inv = color ? 0x00 : 0xFF;
+
+    // scales that are not a power of two fall back to one span per cell
+    if(font_scale & (font_scale - 1))
+    {
+        for(i=0;i<8;i++)
+            for(j=0;j<8;j++)
+                ssd1306_setbuf_rect(x + j*font_scale, y + i*font_scale, font_scale, font_scale,
+                    ((fontdata[(chr<<3)+i] << j) & 0x80) ? color : !color);
+        return;
+    }
+
+    if((x >= TARGET_W) || (ty >= (int32_t)TARGET_H) || (font_scale > 8)) return;
+
+    for(j=0;j<8;j++)
+    {
+        uint32_t cx = x + j*font_scale;
+        if(cx >= (uint32_t)TARGET_W) break;
+
+        // expand vertically by repeated bit doubling
+        col[0] = ssd1306_glyph_col(chr, j) ^ inv;
+        for(n=1;n<font_scale;n*=2)
+        {
+            for(i=n;i--;)
+            {
+                col[2*i+1] = ssd1306_bit2x[col[i] >> 4];
+                col[2*i] = ssd1306_bit2x[col[i] & 15];
+            }
+        }
+
+        // store into every column of the scaled cell, page by page
+        n = (TARGET_W - cx < font_scale) ? TARGET_W - cx : font_scale;
+        for(i=0;i<=font_scale;i++)
+        {
+            int32_t page = page0 + i;
+            uint8_t val, mask = 0xFF;
+            uint8_t *dst;
+
+            if(page >= (int32_t)TARGET_PAGES) break;
+            if(i == font_scale)
+            {
+                // spill of the last byte into the next page
+                if(!shift) break;
+                val = col[i-1] >> (8-shift);
+                mask = 0xFF >> (8-shift);
+            }
+            else
+            {
+                val = col[i] << shift;
+                if(i) val |= col[i-1] >> (8-shift);
+                if(!i) mask = 0xFF << shift;
+            }
+            if(page < 0) continue;
+
+            dst = &TARGET_BUF[cx + TARGET_W*page];
+            SSD1306_DIRTY_SPAN(page, cx, cx+n-1);
+            for(k=0;k<n;k++)
+                dst[k] = (dst[k] & ~mask) | val;
+        }
+    }
+}
+
+/*
+ * draw a string to the display buffer, scaled to size
+ */
+void ssd1306_drawstr_sz(uint8_t x, uint8_t y, char *str, uint8_t color, font_size_t font_size)
+{
+	uint32_t cx = x;
+	uint8_t c;
+	
+	while((c=*str++))
+	{
+		ssd1306_drawchar_sz(cx, y, c, color, font_size);
+		cx += 8 * font_size;
+		if((int32_t)cx > TARGET_W - 8 * (int32_t)font_size)
+			break;
+	}
+}
+
+#if !SSD1306_ROTATE_90
+/*
+ * write 8x8 text straight into controller RAM: one column/page window
+ * for the field, glyph columns streamed in packets
+ */
+uint8_t ssd1306_drawstr_direct(i2c_device_t *dev, uint32_t x, uint32_t page, const char *str, uint8_t color, uint8_t keep)
+{
+	uint8_t tmp[SSD1306_PSZ];
+	uint8_t inv = color ? 0x00 : 0xFF, err;
+	uint32_t n = 8*strlen(str), i, j, k;
+
+#if !SSD1306_FRAMEBUFFER
+	(void)keep;   // no frame buffer to keep the text in
+#endif
+	if((x >= SSD1306_W) || (page >= SSD1306_PAGES) || !n)
+		return 0;
+	if(n > SSD1306_W - x) n = SSD1306_W - x;
+
+	err = ssd1306_window(dev, x, x+n-1, SSD1306_RAM_PAGE(page), SSD1306_RAM_PAGE(page));
+	for(i=0;i<n;i+=k)
+	{
+		k = (n - i > SSD1306_PSZ) ? SSD1306_PSZ : n - i;
+		for(j=0;j<k;j++)
+			tmp[j] = ssd1306_glyph_col(str[(i+j)>>3], (i+j)&7) ^ inv;
+		if(!err)
+			err = ssd1306_write(dev, 0x40, tmp, k);
+#if SSD1306_FRAMEBUFFER
+		if(keep)
+			memcpy(&DISP_BUF[x + i + SSD1306_W*page], tmp, k);
+#endif
+	}
+
+#if SSD1306_FRAMEBUFFER
+#if SSD1306_DIRTY_TRACKING
+	/* controller RAM differs from the buffer without keep, or if a write failed */
+	if(!keep || err)
+		ssd1306_dirty_span(page, x, x+n-1);
+#endif
+#if SSD1306_PAGE_HASH
+	/* panel contents changed either way */
+	DISP_HASH_VALID &= ~(1u<<page);
+#endif
+#endif
+	return err;
+}
+#endif
+
+/*
+ * set up a display list over caller storage
+ */
+void ssd1306_dl_init(ssd1306_dl_t *dl, ssd1306_dl_op_t *ops, uint32_t cap)
+{
+	dl->ops = ops;
+	dl->cap = cap;
+	dl->last_hash = 0;
+	ssd1306_dl_begin(dl);
+}
+
+/*
+ * start recording a frame
+ */
+void ssd1306_dl_begin(ssd1306_dl_t *dl)
+{
+	dl->len = 0;
+	dl->overflow = 0;
+	dl->hash = SSD1306_HASH_INIT;
+}
+
+/*
+ * finish recording, report whether the frame changed
+ */
+uint8_t ssd1306_dl_end(ssd1306_dl_t *dl)
+{
+	return dl->overflow || (dl->hash != dl->last_hash);
+}
+
+/*
+ * append one operation and fold it into the frame hash
+ */
+static void ssd1306_dl_push(ssd1306_dl_t *dl, uint8_t op, uint8_t color, uint8_t size,
+	int32_t x, int32_t y, int32_t a, int32_t b, const void *data)
+{
+	ssd1306_dl_op_t *o;
+
+	if(dl->len >= dl->cap)
+	{
+		dl->overflow = 1;
+		return;
+	}
+
+	o = &dl->ops[dl->len++];
+	o->op = op;
+	o->color = color;
+	o->size = size;
+	o->rsvd = 0;
+	o->x = x;
+	o->y = y;
+	o->a = a;
+	o->b = b;
+	o->data = data;
+
+	/* scalar fields, then the pointer; padding between them (64-bit hosts) is undefined */
+	dl->hash = ssd1306_hash(dl->hash, (const uint8_t *)o, offsetof(ssd1306_dl_op_t, b) + sizeof(o->b));
+	dl->hash = ssd1306_hash(dl->hash, (const uint8_t *)&o->data, sizeof(o->data));
+	if((op == dl_str) || (op == dl_str_sz))
+		dl->hash = ssd1306_hash(dl->hash, data, strlen(data));
+}
+
+void ssd1306_dl_drawPixel(ssd1306_dl_t *dl, int32_t x, int32_t y, int color)
+{
+	ssd1306_dl_push(dl, dl_pixel, color, 0, x, y, 0, 0, NULL);
+}
+
+void ssd1306_dl_drawFastHLine(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_hline, color, 0, x, y, w, 1, NULL);
+}
+
+void ssd1306_dl_drawFastVLine(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t h, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_vline, color, 0, x, y, 1, h, NULL);
+}
+
+void ssd1306_dl_drawLine(ssd1306_dl_t *dl, int x0, int y0, int x1, int y1, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_line, color, 0, x0, y0, x1, y1, NULL);
+}
+
+void ssd1306_dl_drawRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_rect, color, 0, x, y, w, h, NULL);
+}
+
+void ssd1306_dl_fillRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_fillrect, color, 0, x, y, w, h, NULL);
+}
+
+void ssd1306_dl_xorrect(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	ssd1306_dl_push(dl, dl_xorrect, 0, 0, x, y, w, h, NULL);
+}
+
+void ssd1306_dl_drawCircle(ssd1306_dl_t *dl, int x, int y, int radius, int color)
+{
+	ssd1306_dl_push(dl, dl_circle, color, 0, x, y, radius, 0, NULL);
+}
+
+void ssd1306_dl_fillCircle(ssd1306_dl_t *dl, int x, int y, int radius, int color)
+{
+	ssd1306_dl_push(dl, dl_fillcircle, color, 0, x, y, radius, 0, NULL);
+}
+
+void ssd1306_dl_drawRoundRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_roundrect, color, (r > 255) ? 255 : r, x, y, w, h, NULL);
+}
+
+void ssd1306_dl_fillRoundRect(ssd1306_dl_t *dl, int32_t x, int32_t y, uint32_t w, uint32_t h, uint32_t r, uint32_t color)
+{
+	ssd1306_dl_push(dl, dl_fillroundrect, color, (r > 255) ? 255 : r, x, y, w, h, NULL);
+}
+
+void ssd1306_dl_drawstr(ssd1306_dl_t *dl, uint8_t x, uint8_t y, char *str, uint8_t color)
+{
+	ssd1306_dl_push(dl, dl_str, color, 1, x, y, 0, 0, str);
+}
+
+void ssd1306_dl_drawstr_sz(ssd1306_dl_t *dl, uint8_t x, uint8_t y, char *str, uint8_t color, font_size_t font_size)
+{
+	ssd1306_dl_push(dl, dl_str_sz, color, font_size, x, y, 0, 0, str);
+}
+
+void ssd1306_dl_drawImage(ssd1306_dl_t *dl, uint32_t x, uint32_t y, const unsigned char* input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	ssd1306_dl_push(dl, dl_image, color_mode, 0, x, y, width, height, input);
+}
+
+void ssd1306_dl_drawPageImage(ssd1306_dl_t *dl, int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	ssd1306_dl_push(dl, dl_pageimage, color_mode, 0, x, y, width, height, input);
+}
+
+void ssd1306_dl_drawRleImage(ssd1306_dl_t *dl, int32_t x, int32_t y, const uint8_t *input, uint32_t width, uint32_t height, uint32_t color_mode)
+{
+	ssd1306_dl_push(dl, dl_rleimage, color_mode, 0, x, y, width, height, input);
+}
+
+/*
+ * conservative bounding box of a recorded operation
+ */
+static void ssd1306_dl_bbox(const ssd1306_dl_op_t *o, int32_t *x0, int32_t *y0, int32_t *x1, int32_t *y1)
+{
+	switch(o->op)
+	{
+		case dl_pixel:
+			*x0 = *x1 = o->x;
+			*y0 = *y1 = o->y;
+			break;
+		case dl_line:
+			*x0 = (o->x < o->a) ? o->x : o->a;
+			*x1 = (o->x < o->a) ? o->a : o->x;
+			*y0 = (o->y < o->b) ? o->y : o->b;
+			*y1 = (o->y < o->b) ? o->b : o->y;
+			break;
+		case dl_circle:
+		case dl_fillcircle:
+			*x0 = o->x - o->a;
+			*x1 = o->x + o->a;
+			*y0 = o->y - o->a;
+			*y1 = o->y + o->a;
+			break;
+		case dl_str:
+		case dl_str_sz:
+			// strings run to the right edge at most
+			*x0 = o->x;
+			*x1 = SSD1306_W-1;
+			*y0 = o->y;
+			*y1 = o->y + 8*o->size - 1;
+			break;
+		case dl_image:
+			// horizontally packed images start 8 columns right of x
+			*x0 = o->x;
+			*x1 = o->x + o->a + 7;
+			*y0 = o->y;
+			*y1 = o->y + o->b - 1;
+			break;
+		default:
+			*x0 = o->x;
+			*x1 = o->x + o->a - 1;
+			*y0 = o->y;
+			*y1 = o->y + o->b - 1;
+			break;
+	}
+}
+
+/*
+ * replay the operations that touch a rectangle
+ */
+void ssd1306_dl_replay(ssd1306_dl_t *dl, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	const ssd1306_dl_op_t *o = dl->ops;
+	int32_t x0, y0, x1, y1;
+	uint32_t i;
+
+	for(i=0;i<dl->len;i++, o++)
+	{
+		ssd1306_dl_bbox(o, &x0, &y0, &x1, &y1);
+		if((x1 < x) || (x0 >= x + w) || (y1 < y) || (y0 >= y + h))
+			continue;
+
+		switch(o->op)
 		{
-			if(d&0x80)
-				col = color;
-			else
-				col = (~color)&1;
-			
-			ssd1306_drawPixel(x+j, y+i, col);
-			
-			// next bit
-			d <<= 1;
+			case dl_pixel:      ssd1306_drawPixel(o->x, o->y, o->color); break;
+			case dl_hline:      ssd1306_drawFastHLine(o->x, o->y, o->a, o->color); break;
+			case dl_vline:      ssd1306_drawFastVLine(o->x, o->y, o->b, o->color); break;
+			case dl_line:       ssd1306_drawLine(o->x, o->y, o->a, o->b, o->color); break;
+			case dl_rect:       ssd1306_drawRect(o->x, o->y, o->a, o->b, o->color); break;
+			case dl_fillrect:   ssd1306_setbuf_rect(o->x, o->y, o->a, o->b, o->color); break;
+			case dl_xorrect:    ssd1306_xorrect(o->x, o->y, o->a, o->b); break;
+			case dl_circle:     ssd1306_drawCircle(o->x, o->y, o->a, o->color); break;
+			case dl_fillcircle: ssd1306_fillCircle(o->x, o->y, o->a, o->color); break;
+			case dl_roundrect:  ssd1306_drawRoundRect(o->x, o->y, o->a, o->b, o->size, o->color); break;
+			case dl_fillroundrect: ssd1306_fillRoundRect(o->x, o->y, o->a, o->b, o->size, o->color); break;
+			case dl_str:        ssd1306_drawstr(o->x, o->y, (char *)o->data, o->color); break;
+			case dl_str_sz:     ssd1306_drawstr_sz(o->x, o->y, (char *)o->data, o->color, o->size); break;
+			case dl_image:      ssd1306_drawImage(o->x, o->y, o->data, o->a, o->b, o->color); break;
+			case dl_pageimage:  ssd1306_drawPageImage(o->x, o->y, o->data, o->a, o->b, o->color); break;
+			case dl_rleimage:   ssd1306_drawRleImage(o->x, o->y, o->data, o->a, o->b, o->color); break;
 		}
 	}
 }
 
+#if SSD1306_STRIP_PAGES
 /*
- * draw a string to the display
+ * strip callback: replay what intersects the strip being rendered
  */
-void ssd1306_drawstr(uint8_t x, uint8_t y, char *str, uint8_t color)
+void ssd1306_dl_draw_strip(void *arg)
 {
-	uint8_t c;
-	
-	while((c=*str++))
+	ssd1306_dl_replay((ssd1306_dl_t *)arg, 0, TARGET_Y0, SSD1306_W, TARGET_H);
+}
+#endif
+
+/*
+ * render and send a recorded frame, nothing at all if it is unchanged
+ */
+uint8_t ssd1306_dl_render(ssd1306_dl_t *dl, i2c_device_t *dev)
+{
+	uint8_t err = 0;
+
+	if(!ssd1306_dl_end(dl))
+		return 0;
+
+	SSD1306_FB_ENTER();
+#if SSD1306_FRAMEBUFFER
 	{
-		ssd1306_drawchar(x, y, c, color);
-		x += 8;
-		if(x>120)
-			break;
+		SSD1306_TIME_START();
+		ssd1306_setbuf(0);
+		ssd1306_dl_replay(dl, 0, 0, SSD1306_W, SSD1306_H);
+		SSD1306_TIME_END(render_ticks);
 	}
+	err = ssd1306_refresh(dev);
+#else
+	err = ssd1306_render_strips(dev, ssd1306_dl_draw_strip, dl);
+#endif
+	SSD1306_FB_LEAVE();
+
+	if(!err)
+		dl->last_hash = dl->overflow ? 0 : dl->hash;
+	return err;
 }
 
+#if SSD1306_FRAMEBUFFER
 /*
- * Draw character to the display buffer, scaled to size
+ * buffer area a sprite at its current x, y covers
  */
-void ssd1306_drawchar_sz(uint8_t x, uint8_t y, uint8_t chr, uint8_t color, font_size_t font_size)
+static void ssd1306_sprite_box(const ssd1306_sprite_t *s, ssd1306_sprite_box_t *b)
 {
-    uint16_t i, j, col;
-    uint8_t d;
+	int32_t x0 = s->x, y0 = s->y, x1 = s->x + s->w - 1, y1 = s->y + s->h - 1;
 
-    // Determine the font scale factor based on the font_size parameter
-    uint8_t font_scale = (uint8_t)font_size;
+	b->n = 0;
+	if(!s->image || !s->w || !s->h || (x1 < 0) || (y1 < 0) || (x0 >= SSD1306_W) || (y0 >= SSD1306_H))
+		return;
+	if(x0 < 0) x0 = 0;
+	if(y0 < 0) y0 = 0;
+	if(x1 >= SSD1306_W) x1 = SSD1306_W-1;
+	if(y1 >= SSD1306_H) y1 = SSD1306_H-1;
+	b->x = x0;
+	b->n = x1 - x0 + 1;
+	b->p = y0/8;
+	b->np = y1/8 - y0/8 + 1;
+}
 
-    // Loop through each row of the font data
-    for (i = 0; i < 8; i++)
-    {
-        // Retrieve the font data for the current row
-        d = fontdata[(chr << 3) + i];
+/*
+ * grow box a to cover box b as well
+ */
+static void ssd1306_box_union(ssd1306_sprite_box_t *a, const ssd1306_sprite_box_t *b)
+{
+	uint32_t x1, p1;
 
-        // Loop through each column of the font data
-        for (j = 0; j < 8; j++)
-        {
-            // Determine the color to draw based on the current bit in the font data
-            if (d & 0x80)
-                col = color;
-            else
-                col = (~color) & 1;
+	if(!b->n)
+		return;
+	if(!a->n)
+	{
+		*a = *b;
+		return;
+	}
+	x1 = (a->x + a->n > b->x + b->n) ? a->x + a->n : b->x + b->n;
+	p1 = (a->p + a->np > b->p + b->np) ? a->p + a->np : b->p + b->np;
+	if(b->x < a->x) a->x = b->x;
+	if(b->p < a->p) a->p = b->p;
+	a->n = x1 - a->x;
+	a->np = p1 - a->p;
+}
 
-            // Draw the pixel at the original size and scaled size using nested for-loops
-            for (uint8_t k = 0; k < font_scale; k++) {
-                for (uint8_t l = 0; l < font_scale; l++) {
-                    ssd1306_drawPixel(x + (j * font_scale) + k, y + (i * font_scale) + l, col);
-                }
-            }
+#if !SSD1306_ROTATE_90
+// boxes ssd1306_sprites_refresh() keeps apart before joining the rest
+#define SSD1306_SPRITE_BOXES 8
 
-            // Move to the next bit in the font data
-            d <<= 1;
-        }
-    }
+/*
+ * bus bytes of ssd1306_refresh_rect() for a box
+ */
+static uint32_t ssd1306_box_cost(const ssd1306_sprite_box_t *b)
+{
+	return SSD1306_WINDOW_BYTES + b->np * (b->n + 2);
 }
 
 /*
- * draw a string to the display buffer, scaled to size
+ * add a box to the refresh list, joined with listed boxes as long as one
+ * window is cheaper than two
  */
-void ssd1306_drawstr_sz(uint8_t x, uint8_t y, char *str, uint8_t color, font_size_t font_size)
+static void ssd1306_box_add(ssd1306_sprite_box_t *r, uint32_t *cnt, ssd1306_sprite_box_t b)
 {
-	uint8_t c;
-	
-	while((c=*str++))
+	ssd1306_sprite_box_t u;
+	uint32_t i;
+
+	if(!b.n)
+		return;
+	for(;;)
 	{
-		ssd1306_drawchar_sz(x, y, c, color, font_size);
-		x += 8 * font_size;
-		if(x>128 - 8 * font_size)
+		for(i=0;i<*cnt;i++)
+		{
+			u = r[i];
+			ssd1306_box_union(&u, &b);
+			if(ssd1306_box_cost(&u) <= ssd1306_box_cost(&r[i]) + ssd1306_box_cost(&b))
+				break;
+		}
+		if(i == *cnt)
 			break;
+		/* the union may now reach other boxes, take it out and try again */
+		b = u;
+		r[i] = r[--*cnt];
+	}
+	if(*cnt < SSD1306_SPRITE_BOXES)
+		r[(*cnt)++] = b;
+	else
+		ssd1306_box_union(&r[*cnt-1], &b);
+}
+#endif
+
+/*
+ * set up a hidden sprite
+ */
+void ssd1306_sprite_init(ssd1306_sprite_t *s, const uint8_t *image, uint32_t w, uint32_t h, uint32_t mode, uint8_t *save)
+{
+	memset(s, 0, sizeof(*s));
+	s->image = image;
+	s->save = save;
+	s->w = w;
+	s->h = h;
+	s->mode = mode;
+}
+
+/*
+ * take the sprites off in reverse order, so every one restores what was
+ * there before it was drawn, sprites below included
+ */
+void ssd1306_sprites_erase(ssd1306_sprite_t *s, uint32_t n)
+{
+	ssd1306_sprite_t *t;
+	uint32_t p;
+	SSD1306_FB_ENTER();
+
+	while(n--)
+	{
+		t = &s[n];
+		if(!t->box.n)
+			continue;
+		if(t->save)
+		{
+			for(p=0;p<t->box.np;p++)
+				memcpy(&TARGET_BUF[t->box.x + SSD1306_W*(t->box.p+p)], &t->save[t->box.n*p], t->box.n);
+			SSD1306_DIRTY_RECT(t->box.x, 8*t->box.p, t->box.n, 8*t->box.np);
+		}
+		else
+			ssd1306_drawPageImage(t->dx, t->dy, t->drawn, t->w, t->h, imagemode_xor);
+		ssd1306_box_union(&t->old, &t->box);
+		t->box.n = 0;
+	}
+	SSD1306_FB_LEAVE();
+}
+
+/*
+ * save what is under every sprite, then blend it in
+ */
+void ssd1306_sprites_draw(ssd1306_sprite_t *s, uint32_t n)
+{
+	uint32_t p;
+	SSD1306_FB_ENTER();
+
+	for(;n;n--,s++)
+	{
+		ssd1306_sprite_box(s, &s->box);
+		if(!s->box.n)
+			continue;
+		if(s->save)
+			for(p=0;p<s->box.np;p++)
+				memcpy(&s->save[s->box.n*p], &TARGET_BUF[s->box.x + SSD1306_W*(s->box.p+p)], s->box.n);
+		ssd1306_drawPageImage(s->x, s->y, s->image, s->w, s->h, s->save ? s->mode : imagemode_xor);
+		s->drawn = s->image;
+		s->dx = s->x;
+		s->dy = s->y;
+	}
+	SSD1306_FB_LEAVE();
+}
+
+/*
+ * send the old and new sprite areas
+ */
+uint8_t ssd1306_sprites_refresh(i2c_device_t *dev, ssd1306_sprite_t *s, uint32_t n)
+{
+	uint8_t err = 0;
+	uint32_t i;
+#if SSD1306_ROTATE_90
+	err = ssd1306_refresh(dev);
+#else
+	ssd1306_sprite_box_t r[SSD1306_SPRITE_BOXES];
+	uint32_t cnt = 0;
+
+	for(i=0;i<n;i++)
+	{
+		ssd1306_box_add(r, &cnt, s[i].old);
+		ssd1306_box_add(r, &cnt, s[i].box);
+	}
+	for(i=0;i<cnt;i++)
+		err |= ssd1306_refresh_rect(dev, r[i].x, 8*r[i].p, r[i].n, 8*r[i].np);
+#endif
+	if(!err)
+		for(i=0;i<n;i++)
+			s[i].old.n = 0;
+	return err;
+}
+
+/*
+ * one animation frame
+ */
+uint8_t ssd1306_sprites_update(i2c_device_t *dev, ssd1306_sprite_t *s, uint32_t n)
+{
+	ssd1306_sprites_erase(s, n);
+	ssd1306_sprites_draw(s, n);
+	return ssd1306_sprites_refresh(dev, s, n);
+}
+#endif
+
+#if SSD1306_CANVAS
+/*
+ * attach and clear a canvas buffer
+ */
+void ssd1306_canvas_init(ssd1306_canvas_t *c, uint8_t *buf, uint32_t w, uint32_t h)
+{
+	c->buf = buf;
+	c->w = w;
+	c->h = h;
+	memset(buf, 0, SSD1306_CANVAS_SIZE(w, h));
+}
+
+/*
+ * make a canvas the drawing target, switching between canvases keeps
+ * the target from before the first one
+ */
+void ssd1306_canvas_begin(ssd1306_canvas_t *c)
+{
+	if(!ssd1306_canvas_on)
+		ssd1306_canvas_prev = ssd1306_target;
+	ssd1306_canvas_on = 1;
+
+	ssd1306_target.buf = c->buf;
+	ssd1306_target.y0 = 0;
+	ssd1306_target.pages = (c->h + 7) / 8;
+	ssd1306_target.dirty = 0;
+	ssd1306_target.w = c->w;
+}
+
+/*
+ * back to the frame buffer (or strip)
+ */
+void ssd1306_canvas_end(void)
+{
+	if(!ssd1306_canvas_on)
+		return;
+	ssd1306_target = ssd1306_canvas_prev;
+	ssd1306_canvas_on = 0;
+}
+
+/*
+ * a canvas is a page-format image, so blitting is drawing it
+ */
+void ssd1306_blit(const ssd1306_canvas_t *c, int32_t x, int32_t y, uint32_t color_mode)
+{
+	ssd1306_drawPageImage(x, y, c->buf, c->w, c->h, color_mode);
+}
+#endif
+
+#if SSD1306_CONSOLE
+// console state: the text line being built, its display page and column
+static uint8_t ssd1306_con_line[SSD1306_W];
+static uint8_t ssd1306_con_row, ssd1306_con_x;
+static uint8_t ssd1306_con_dirty;   // line has unsent changes
+static uint8_t ssd1306_con_scroll;  // line goes below the bottom, scroll when sent
+
+/*
+ * the console wrote controller RAM behind the frame buffer's back
+ */
+static void ssd1306_con_invalidate(void)
+{
+#if SSD1306_DIRTY_TRACKING
+	ssd1306_dirty_all();
+#endif
+#if SSD1306_PAGE_HASH
+	DISP_HASH_VALID = 0;
+#endif
+}
+
+/*
+ * clear the panel and home the console
+ */
+uint8_t ssd1306_console_init(i2c_device_t *dev)
+{
+	uint32_t page;
+	uint8_t err;
+
+	err = ssd1306_send_start_line(dev, 0);
+	memset(ssd1306_con_line, 0, SSD1306_W);
+	for(page=0;page<SSD1306_PAGES;page++)
+		err |= ssd1306_send_pages(dev, ssd1306_con_line, page, 1);
+
+	ssd1306_con_row = 0;
+	ssd1306_con_x = 0;
+	ssd1306_con_dirty = 0;
+	ssd1306_con_scroll = 0;
+	ssd1306_con_invalidate();
+	return err;
+}
+
+/*
+ * send the current line; a line below the bottom goes to the RAM page
+ * that scrolls into view and the start line moves after it is written
+ */
+uint8_t ssd1306_console_flush(i2c_device_t *dev)
+{
+	uint8_t err;
+
+	if(!ssd1306_con_dirty && !ssd1306_con_scroll)
+		return 0;
+
+	err = ssd1306_send_pages(dev, ssd1306_con_line,
+		ssd1306_con_row + ssd1306_con_scroll, 1);
+	if(ssd1306_con_scroll && !err)
+		err = ssd1306_send_start_line(dev, DISP_START_LINE + 8);
+	if(!err)
+	{
+		ssd1306_con_dirty = 0;
+		ssd1306_con_scroll = 0;
+	}
+	ssd1306_con_invalidate();
+	return err;
+}
+
+/*
+ * finish the current line and start an empty one below it
+ */
+static uint8_t ssd1306_con_newline(i2c_device_t *dev)
+{
+	uint8_t err = ssd1306_console_flush(dev);
+
+	memset(ssd1306_con_line, 0, SSD1306_W);
+	ssd1306_con_x = 0;
+	if(ssd1306_con_row < SSD1306_PAGES-1)
+		ssd1306_con_row++;
+	else
+		ssd1306_con_scroll = 1;
+	return err;
+}
+
+/*
+ * put one character on the console
+ */
+uint8_t ssd1306_console_putc(i2c_device_t *dev, char c)
+{
+	uint32_t j;
+	uint8_t err = 0;
+
+	if(c == '\n')
+		return ssd1306_con_newline(dev);
+	if(c == '\r')
+	{
+		ssd1306_con_x = 0;
+		return 0;
 	}
+
+	if(ssd1306_con_x > SSD1306_W-8)
+		err = ssd1306_con_newline(dev);
+
+	/* glyph columns straight into the line (overwrites after '\r') */
+	for(j=0;j<8;j++)
+		ssd1306_con_line[ssd1306_con_x + j] = ssd1306_glyph_col(c, j);
+	ssd1306_con_x += 8;
+	ssd1306_con_dirty = 1;
+	return err;
+}
+
+/*
+ * put a string on the console and show the unfinished line, a trailing
+ * new line only scrolls once there is text for it
+ */
+uint8_t ssd1306_console_puts(i2c_device_t *dev, const char *str)
+{
+	uint8_t err = 0;
+
+	while(*str)
+		err |= ssd1306_console_putc(dev, *str++);
+	if(ssd1306_con_dirty)
+		err |= ssd1306_console_flush(dev);
+	return err;
 }
+#endif
 
 /*
  * initialize I2C and OLED
@@ -601,18 +3369,30 @@ uint8_t ssd1306_init(i2c_device_t *dev)
 	// pulse reset
 	ssd1306_rst();
 
+#if SSD1306_MULTI
+	ssd1306_disp->dev = dev;
+#endif
 	ssd1306_setbuf(0);
+	DISP_START_LINE = 0;
+#if SSD1306_PAGE_HASH
+	ssd1306_refresh_invalidate();
+#endif
 	
 	// initialize OLED
 #if !defined(SSD1306_CUSTOM_INIT_ARRAY) || !SSD1306_CUSTOM_INIT_ARRAY
-	uint8_t *cmd_list = (uint8_t *)ssd1306_init_array;
-	while(*cmd_list != SSD1306_TERMINATE_CMDS)
-	{
-		if(ssd1306_cmd(dev, *cmd_list++))
-			return 1;
-	}
+	// whole init sequence in one transaction
+	int cmd_len = 0;
+	while(ssd1306_init_array[cmd_len] != SSD1306_TERMINATE_CMDS)
+		cmd_len++;
+	if(ssd1306_cmds(dev, ssd1306_init_array, cmd_len))
+		return 1;
 	
+#if SSD1306_FRAMEBUFFER
 	ssd1306_refresh(dev);	
+#else
+	// no frame buffer, clear the panel strip by strip
+	ssd1306_render_strips(dev, NULL, NULL);
+#endif
 #endif
 
 	return 0;
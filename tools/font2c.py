@@ -0,0 +1,259 @@
+"""
+Convert a bitmap font into an ssd1306_font_t descriptor for
+ssd1306_drawstr_font(), keeping only the characters that are needed.
+
+Input is either a BDF font (e.g. the X11 5x7, 6x13 or 12x24 fonts) or an
+8x8 C array in the font_8x8.h layout (8 row bytes per glyph, leftmost pixel
+in bit 7). Glyphs are stored as page-format images: (height+7)/8 pages of
+glyph width bytes, bit 0 = top row. Fonts whose glyphs all have the same
+width get no width/offset tables.
+
+Usage:
+    python tools/font2c.py 5x7.bdf -n font5x7 --chars "0123456789.:-"
+    python tools/font2c.py 12x24.bdf -n digits12 --chars "0123456789" -o include/digits12.h
+    python tools/font2c.py font_8x8.h -n font8p --proportional --scan src
+    python tools/font2c.py font_8x8.h -n font8 --range 0x20-0x7e
+
+--scan collects the characters of every string and character literal in
+the given C files or directories, so the font holds what the firmware can
+actually print. --chars and --range add to that; with none of them all
+glyphs are kept.
+
+Also runs as a PlatformIO pre-build script: every line of the
+custom_fonts option of the environment is "source name [options]" and
+generates include/<name>.h, scanning src/ when no characters are given.
+"""
+
+import argparse
+import os
+import re
+import shlex
+import sys
+
+
+def read_c8x8(path):
+    """glyphs {code: (width, rows of 0/1)} from a font_8x8.h style array"""
+    with open(path) as f:
+        text = f.read()
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"//[^\n]*", "", text)
+    body = text[text.index("{") + 1:]
+    body = body[:body.index("}")]
+    values = [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+    glyphs = {}
+    for c in range(len(values) // 8):
+        glyphs[c] = (8, [[(values[c * 8 + y] >> (7 - x)) & 1 for x in range(8)]
+                         for y in range(8)])
+    return glyphs, 8
+
+
+def read_bdf(path):
+    """glyphs {code: (advance, rows of 0/1)} and cell height from a BDF font"""
+    with open(path) as f:
+        lines = f.read().splitlines()
+    ascent = descent = None
+    box = None
+    glyphs = {}
+    i = 0
+    while i < len(lines):
+        words = lines[i].split()
+        i += 1
+        if not words:
+            continue
+        if words[0] == "FONTBOUNDINGBOX":
+            box = [int(v) for v in words[1:5]]
+        elif words[0] == "FONT_ASCENT":
+            ascent = int(words[1])
+        elif words[0] == "FONT_DESCENT":
+            descent = int(words[1])
+        elif words[0] == "STARTCHAR":
+            code = advance = bbx = None
+            bitmap = []
+            while i < len(lines) and lines[i].split()[:1] != ["ENDCHAR"]:
+                w = lines[i].split()
+                i += 1
+                if not w:
+                    continue
+                if w[0] == "ENCODING":
+                    code = int(w[1])
+                elif w[0] == "DWIDTH":
+                    advance = int(w[1])
+                elif w[0] == "BBX":
+                    bbx = [int(v) for v in w[1:5]]
+                elif w[0] == "BITMAP":
+                    while i < len(lines) and lines[i].split()[:1] != ["ENDCHAR"]:
+                        bitmap.append(int(lines[i].strip(), 16) if lines[i].strip() else 0)
+                        i += 1
+            i += 1
+            if code is not None and 0 <= code < 256:
+                glyphs[code] = (advance, bbx, bitmap)
+    if ascent is None or descent is None:
+        ascent, descent = box[1] + box[3], -box[3]
+    height = ascent + descent
+
+    out = {}
+    for code, (advance, bbx, bitmap) in glyphs.items():
+        w, h, xoff, yoff = bbx
+        if advance is None:
+            advance = w + xoff
+        rows = [[0] * advance for _ in range(height)]
+        nbits = ((w + 7) // 8) * 8
+        for r, bits in enumerate(bitmap[:h]):
+            y = ascent - (yoff + h) + r
+            for c in range(w):
+                x = xoff + c
+                if 0 <= y < height and 0 <= x < advance and (bits >> (nbits - 1 - c)) & 1:
+                    rows[y][x] = 1
+        out[code] = (advance, rows)
+    return out, height
+
+
+def trim(glyphs, space):
+    """proportional widths: drop blank columns left and right of every glyph"""
+    out = {}
+    for code, (width, rows) in glyphs.items():
+        used = [x for x in range(width) if any(row[x] for row in rows)]
+        if not used:
+            out[code] = (space, [[0] * space for _ in rows])
+            continue
+        x0, x1 = used[0], used[-1] + 1
+        out[code] = (x1 - x0, [row[x0:x1] for row in rows])
+    return out
+
+
+def unescape(s):
+    return re.sub(r"\\(x[0-9a-fA-F]{1,2}|[0-7]{1,3}|.)",
+                  lambda m: {"n": "\n", "t": "\t", "r": "\r", "0": "\0"}.get(m.group(1)) or
+                  (chr(int(m.group(1)[1:], 16)) if m.group(1)[0] == "x" else
+                   chr(int(m.group(1), 8)) if m.group(1)[0] in "01234567" else m.group(1)), s)
+
+
+def scan(paths):
+    """characters of all string and character literals in C sources"""
+    chars = set()
+    files = []
+    for p in paths:
+        if os.path.isdir(p):
+            for root, _, names in os.walk(p):
+                files += [os.path.join(root, n) for n in names if n.endswith((".c", ".h", ".cpp"))]
+        else:
+            files.append(p)
+    for path in files:
+        with open(path, errors="replace") as f:
+            text = f.read()
+        text = re.sub(r"/\*.*?\*/|//[^\n]*", "", text, flags=re.S)
+        text = re.sub(r"^\s*#\s*include[^\n]*", "", text, flags=re.M)
+        for lit in re.findall(r"\"((?:[^\"\\\n]|\\.)*)\"|'((?:[^'\\\n]|\\.)+)'", text):
+            chars.update(unescape(lit[0] or lit[1]))
+    return {ord(c) for c in chars if ord(c) < 256}
+
+
+def to_pages(width, rows):
+    out = []
+    for page in range((len(rows) + 7) // 8):
+        for x in range(width):
+            b = 0
+            for bit in range(8):
+                y = page * 8 + bit
+                if y < len(rows) and rows[y][x]:
+                    b |= 1 << bit
+            out.append(b)
+    return out
+
+
+def generate(args):
+    if args.input.lower().endswith(".bdf"):
+        glyphs, height = read_bdf(args.input)
+    else:
+        glyphs, height = read_c8x8(args.input)
+    if args.proportional:
+        glyphs = trim(glyphs, args.space)
+
+    wanted = set()
+    if args.scan:
+        wanted |= scan(args.scan)
+    if args.chars:
+        wanted |= {ord(c) for c in unescape(args.chars)}
+    for r in args.range or []:
+        a, b = (int(v, 0) for v in r.split("-"))
+        wanted |= set(range(a, b + 1))
+    codes = sorted(c for c in glyphs if not wanted or c in wanted)
+    if not codes:
+        sys.exit("font2c: no glyphs left")
+    missing = sorted(c for c in wanted if c not in glyphs and c >= 0x20)
+    if missing:
+        sys.stderr.write("font2c: not in font: %r\n" % "".join(chr(c) for c in missing))
+
+    first, last = codes[0], codes[-1]
+    widths = [glyphs[c][0] if c in codes else 0 for c in range(first, last + 1)]
+    fixed = len({glyphs[c][0] for c in codes}) == 1 and len(codes) == last - first + 1
+    spacing = args.spacing if args.spacing is not None else (1 if args.proportional else 0)
+
+    name = args.name
+    bitmap, offsets = [], []
+    lines = ["/* generated by tools/font2c.py from %s - do not edit */" % os.path.basename(args.input),
+             "/* include from one source file, declare it extern elsewhere */",
+             "", "#include \"myssd1306.h\"", "",
+             "// %d glyphs, %d pixels high" % (len(codes), height),
+             "static const uint8_t %s_bitmap[] = {" % name]
+    for c in range(first, last + 1):
+        offsets.append(len(bitmap))
+        if c not in codes:
+            continue
+        data = to_pages(*glyphs[c])
+        bitmap += data
+        label = chr(c) if 0x20 < c < 0x7f and chr(c) not in "\\" else "0x%02x" % c
+        lines.append("\t" + ", ".join("0x%02x" % b for b in data) + ",  // %s" % label)
+    lines.append("};")
+    if not fixed:
+        if len(bitmap) > 0xFFFF:
+            sys.exit("font2c: font too large for 16-bit offsets")
+        lines.append("static const uint16_t %s_offset[] = {" % name)
+        for i in range(0, len(offsets), 12):
+            lines.append("\t" + ", ".join("%d" % v for v in offsets[i:i + 12]) + ",")
+        lines += ["};", "static const uint8_t %s_width[] = {" % name]
+        for i in range(0, len(widths), 16):
+            lines.append("\t" + ", ".join("%d" % v for v in widths[i:i + 16]) + ",")
+        lines.append("};")
+    lines += ["const ssd1306_font_t %s = {" % name,
+              "\t%s_bitmap, %s, %s, 0x%02x, 0x%02x, %d, %d, %d" % (
+                  name, "NULL" if fixed else name + "_offset", "NULL" if fixed else name + "_width",
+                  first, last, height, widths[0] if fixed else 0, spacing),
+              "};", ""]
+
+    sys.stderr.write("font2c: %s: %d glyphs, %d bitmap bytes\n" % (name, len(codes), len(bitmap)))
+    out = open(args.output, "w") if args.output else sys.stdout
+    out.write("\n".join(lines))
+    if args.output:
+        out.close()
+
+
+def parser():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("input")
+    ap.add_argument("-n", "--name", required=True, help="C name of the ssd1306_font_t")
+    ap.add_argument("-o", "--output", help="output file (default: stdout)")
+    ap.add_argument("--chars", help="characters to keep (C escapes allowed)")
+    ap.add_argument("--range", action="append", metavar="A-B", help="character codes to keep")
+    ap.add_argument("--scan", action="append", metavar="PATH", help="keep characters used in C literals")
+    ap.add_argument("--proportional", action="store_true", help="trim blank glyph columns")
+    ap.add_argument("--space", type=int, default=3, help="width of blank glyphs with --proportional")
+    ap.add_argument("--spacing", type=int, help="blank columns after each glyph")
+    return ap
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    root = env.subst("$PROJECT_DIR")  # noqa: F821
+    for line in env.GetProjectOption("custom_fonts", "").splitlines():  # noqa: F821
+        if not line.strip():
+            continue
+        words = shlex.split(line)
+        args = parser().parse_args([os.path.join(root, words[0]), "-n", words[1]] + words[2:])
+        if not (args.chars or args.range or args.scan):
+            args.scan = [os.path.join(root, "src")]
+        args.output = args.output or os.path.join(root, "include", args.name + ".h")
+        generate(args)
+except NameError:
+    if __name__ == "__main__":
+        generate(parser().parse_args())
@@ -0,0 +1,73 @@
+"""
+Generate include/font_8x8_cm.h, a column-major copy of fontdata.
+
+font_8x8.h stores each glyph as 8 rows with the leftmost pixel in bit 7.
+The SSD1306 buffer stores 8 vertical pixels per byte, so a transposed font
+lets ssd1306_drawchar() write one byte per glyph column.
+
+Runs as a PlatformIO pre-build script (see platformio.ini), and can also be
+run by hand: python tools/gen_font_cm.py [font_8x8.h [font_8x8_cm.h]]
+"""
+
+import os
+import re
+import sys
+
+SRC = os.path.join("include", "font_8x8.h")
+DST = os.path.join("include", "font_8x8_cm.h")
+
+
+def read_font(path):
+    with open(path) as f:
+        text = f.read()
+    # drop comments, they often contain hex character codes
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    text = re.sub(r"//[^\n]*", "", text)
+    body = text[text.index("{", text.index("fontdata")) + 1:]
+    body = body[:body.index("}")]
+    return [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+
+
+def transpose(rows):
+    cols = []
+    for j in range(8):
+        b = 0
+        for i in range(8):
+            if rows[i] & (0x80 >> j):
+                b |= 1 << i
+        cols.append(b)
+    return cols
+
+
+def generate(src, dst):
+    if os.path.exists(dst) and os.path.getmtime(dst) >= os.path.getmtime(src):
+        return
+    font = read_font(src)
+    out = [
+        "/* generated by tools/gen_font_cm.py from font_8x8.h - do not edit */",
+        "",
+        "#ifndef _FONT_8X8_CM_H",
+        "#define _FONT_8X8_CM_H",
+        "",
+        "// one byte per glyph column, bit 0 = top row",
+        "static const unsigned char fontdata_cm[] = {",
+    ]
+    for c in range(len(font) // 8):
+        cols = transpose(font[c * 8:c * 8 + 8])
+        out.append("\t" + ", ".join("0x%02x" % b for b in cols) + ",  // 0x%02x" % c)
+    out += ["};", "", "#endif", ""]
+    with open(dst, "w") as f:
+        f.write("\n".join(out))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    root = env.subst("$PROJECT_DIR")  # noqa: F821
+    generate(os.path.join(root, SRC), os.path.join(root, DST))
+    env.Append(CPPDEFINES=["SSD1306_FONT_CM"])  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        root = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+        src = sys.argv[1] if len(sys.argv) > 1 else os.path.join(root, SRC)
+        dst = sys.argv[2] if len(sys.argv) > 2 else os.path.join(root, DST)
+        generate(src, dst)
@@ -0,0 +1,153 @@
+"""
+Convert a bitmap into the page format used by ssd1306_drawPageImage().
+
+Page format matches ssd1306_buffer: the image is cut into 8-pixel tall
+pages, each page is `width` bytes, one byte per column with bit 0 = top
+row. Pixels that are set (black in a PBM, non-zero in other images) become
+1 bits.
+
+Usage:
+    python tools/img2page.py icon.pbm [-n name] [-o icon.h]
+    python tools/img2page.py icon.png [-n name] [--threshold 128]   (needs Pillow)
+    python tools/img2page.py array.txt --hbitmap 32x32 [-n name]
+    python tools/img2page.py splash.pbm --rle [-n name]
+
+--hbitmap reads comma separated C array values of a horizontally packed
+bitmap (8 pixels per byte, MSB = leftmost), e.g. an existing drawImage asset.
+
+--rle compresses the page bytes for ssd1306_drawRleImage() and
+ssd1306_streamRleImage(): a control byte 0x00-0x7F is followed by 1-128
+literal bytes, 0x80-0xFF by one byte repeated 2-129 times.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+
+def read_pbm(data):
+    """return (width, height, rows of 0/1) from a P1 or P4 PBM"""
+    tokens = []
+    pos = 0
+    magic = data[:2]
+    # header: magic, width, height - skipping comments
+    while len(tokens) < 3:
+        m = re.compile(rb"\s*(#[^\n]*\n\s*)*(\S+)").match(data, pos)
+        tokens.append(m.group(2))
+        pos = m.end()
+    width, height = int(tokens[1]), int(tokens[2])
+    if magic == b"P4":
+        pos += 1
+        stride = (width + 7) // 8
+        rows = []
+        for y in range(height):
+            line = data[pos + y * stride:pos + (y + 1) * stride]
+            rows.append([(line[x // 8] >> (7 - x % 8)) & 1 for x in range(width)])
+        return width, height, rows
+    if magic == b"P1":
+        bits = [int(b) for b in re.findall(rb"[01]", data[pos:])]
+        return width, height, [bits[y * width:(y + 1) * width] for y in range(height)]
+    raise ValueError("not a PBM file")
+
+
+def read_image(path, threshold):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:2] in (b"P1", b"P4"):
+        return read_pbm(data)
+    from PIL import Image  # only needed for non-PBM input
+    img = Image.open(path).convert("L")
+    width, height = img.size
+    px = img.load()
+    return width, height, [[1 if px[x, y] >= threshold else 0 for x in range(width)]
+                           for y in range(height)]
+
+
+def read_hbitmap(path, size):
+    width, height = (int(v) for v in size.lower().split("x"))
+    with open(path) as f:
+        text = re.sub(r"/\*.*?\*/|//[^\n]*", "", f.read(), flags=re.S)
+    if "{" in text:
+        text = text[text.index("{") + 1:text.index("}")]
+    values = [int(v, 0) for v in re.findall(r"0[xX][0-9a-fA-F]+|\d+", text)]
+    stride = (width + 7) // 8
+    return width, height, [[(values[y * stride + x // 8] >> (7 - x % 8)) & 1
+                            for x in range(width)] for y in range(height)]
+
+
+def to_pages(width, height, rows):
+    out = []
+    for page in range((height + 7) // 8):
+        for x in range(width):
+            b = 0
+            for bit in range(8):
+                y = page * 8 + bit
+                if y < height and rows[y][x]:
+                    b |= 1 << bit
+            out.append(b)
+    return out
+
+
+def rle(data):
+    """PackBits style runs: repeats of 3 or more, of 2 outside literals"""
+    out = []
+    lit = []
+    i = 0
+    while i < len(data):
+        run = 1
+        while i + run < len(data) and run < 129 and data[i + run] == data[i]:
+            run += 1
+        if run >= 3 or (run == 2 and not lit):
+            if lit:
+                out += [len(lit) - 1] + lit
+                lit = []
+            out += [0x80 | (run - 2), data[i]]
+            i += run
+            continue
+        lit.append(data[i])
+        i += 1
+        if len(lit) == 128:
+            out += [127] + lit
+            lit = []
+    if lit:
+        out += [len(lit) - 1] + lit
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    ap.add_argument("input")
+    ap.add_argument("-n", "--name", help="C array name (default: file name)")
+    ap.add_argument("-o", "--output", help="output file (default: stdout)")
+    ap.add_argument("--threshold", type=int, default=128)
+    ap.add_argument("--hbitmap", metavar="WxH", help="input is a horizontally packed C array")
+    ap.add_argument("--rle", action="store_true", help="run-length compress the output")
+    args = ap.parse_args()
+
+    if args.hbitmap:
+        width, height, rows = read_hbitmap(args.input, args.hbitmap)
+    else:
+        width, height, rows = read_image(args.input, args.threshold)
+    name = args.name or re.sub(r"\W", "_", os.path.splitext(os.path.basename(args.input))[0])
+    data = to_pages(width, height, rows)
+    kind = "page-format image, draw with ssd1306_drawPageImage()"
+    if args.rle:
+        raw = len(data)
+        data = rle(data)
+        kind = "RLE page-format image (%d of %d bytes), draw with ssd1306_drawRleImage()" % (len(data), raw)
+
+    lines = ["// %dx%d %s" % (width, height, kind),
+             "const uint8_t %s[] = {" % name]
+    for i in range(0, len(data), 12):
+        lines.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 12]) + ",")
+    lines += ["};",
+              "const uint32_t %s_width = %d;" % (name, width),
+              "const uint32_t %s_height = %d;" % (name, height), ""]
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    out.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()